@@ -8,8 +8,22 @@ SUMMARY:
     
     Allocator that allocate chunks or memory and never free until the allocator itself is destroyed.
     The capacity of a chunk is a multiple of a chunk_min_capacity provided when the allocator is created.
+    With re_arena_options.chunk_max_capacity the capacity doubles at each new chunk up to this max,
+    so the number of chunks grows logarithmically with the allocated memory.
     Each chunk are stored as header of the allocated memory and count as used memory.
 
+    An allocation too big for a new chunk, or bigger than re_arena_options.large_threshold,
+    gets a chunk of its own kept in a separate list. The current chunk is still used for
+    the next allocations so its remaining space is not lost.
+    Those large chunks are kept on clear/rollback and reused by large allocations that fit in them.
+
+    With re_arena_options.reserve_size the arena reserves a contiguous range of virtual memory
+    and commits its pages as the allocations advance, instead of allocating chunks.
+    All allocations are contiguous and the range is never moved.
+
+    With re_arena_options.huge_pages the memory is backed by huge pages to reduce TLB misses
+    when big structures allocated in the arena are traversed.
+
     The allocator can be cleared and reuse without deallocating memory.
 
     Do this
@@ -24,6 +38,15 @@ NOTES:
     Non-virtual allocation are aligned by default but can be disable with:
         #define RE_AA_ALIGN_MALLOC (0)
 
+    re_arena_alloc aligns memory on the natural alignment of the size (the lowest bit set of the size),
+    capped to RE_AA_ALIGNMENT: 1 for a 3-byte string, 8 for a 24-byte struct, 16 for anything bigger and multiple of 16.
+    Use re_arena_alloc_aligned for a bigger alignment (SIMD buffers, cache lines).
+    Max natural alignment can be redefined with:
+        #define RE_AA_ALIGNMENT (16)
+
+    Size of the huge pages used with re_arena_options.huge_pages can be redefined with:
+        #define RE_AA_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
     Assert can be redefined with:
         #define RE_AA_ASSERT(x) my_assert(x)
 
@@ -79,19 +102,15 @@ EXAMPLE:
 #define RE_AA_ALIGNMENT (sizeof(void*) * 2)
 #endif
 
+#ifndef RE_AA_HUGE_PAGE_SIZE
+#define RE_AA_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+#endif
+
 /* Is ignored if RE_AA_VIRTUAL_ALLOC is used */
 #ifndef RE_AA_ALIGN_MALLOC
 #define RE_AA_ALIGN_MALLOC (1)
 #endif
 
-#ifdef RE_AA_VIRTUAL_ALLOC
-#ifdef _WIN32
-#include <windows.h>  /* VirtualAlloc */
-#else
-#include <sys/mman.h> /* mmap */
-#endif
-#endif
-
 #include "stddef.h" /* ptrdiff_t */
 
 #define RE_AA_SIZEOF_CHUNK_ALIGNED (align_up(sizeof(re_chunk), RE_AA_ALIGNMENT))
@@ -108,7 +127,42 @@ typedef struct re_arena re_arena;
 struct re_arena {
     re_chunk* first;
     re_chunk* last;
+    re_chunk* large;      /* Chunks of large allocations in use, the most recent first. */
+    re_chunk* large_free; /* Chunks of large allocations released by clear/rollback. */
     size_t chunk_min_capacity;
+    size_t chunk_max_capacity;  /* 0 if all chunks have the min capacity */
+    size_t chunk_next_capacity; /* capacity of the next chunk, doubles up to chunk_max_capacity */
+    size_t large_threshold;     /* SIZE_MAX if there is no threshold */
+    size_t reserve_size;        /* Size of the reserved range, 0 if chunks are allocated */
+    size_t commit_size;         /* Pages are committed by multiple of this size */
+    size_t decommit_threshold;  /* Committed memory kept on clear in reserve mode, 0 to keep everything */
+    int huge_pages;             /* Chunks are backed by huge pages */
+};
+
+/* Optional settings provided to re_arena_init_ex. */
+typedef struct re_arena_options re_arena_options;
+struct re_arena_options {
+    /* Double the capacity of each new chunk until this capacity is reached, must be a power of two.
+       0 (the default) to allocate all chunks with the min capacity. */
+    size_t chunk_max_capacity;
+    /* Allocations bigger than this get their own chunk instead of being bumped into the current one.
+       0 (the default) to only do it for allocations which do not fit in a new chunk. */
+    size_t large_threshold;
+    /* Reserve this many bytes of address space (64 GB for instance) at the first allocation
+       and commit them by multiple of chunk_min_capacity instead of allocating chunks.
+       The arena has a single chunk and never uses the large list.
+       0 (the default) to allocate chunks. */
+    size_t reserve_size;
+    /* In reserve mode, re_arena_clear decommits the pages above this size to give them back to the system.
+       0 (the default) to keep all pages committed. */
+    size_t decommit_threshold;
+    /* Back the memory with huge pages (RE_AA_HUGE_PAGE_SIZE) to reduce TLB misses on big arenas.
+       Chunks are mapped directly and their capacity is a multiple of the huge page size,
+       explicit huge pages (MAP_HUGETLB, MEM_LARGE_PAGES) are used if the system has some available,
+       otherwise transparent huge pages are requested with madvise(MADV_HUGEPAGE).
+       In reserve mode the range is aligned on huge pages and committed by multiple of them.
+       Regular pages are used if the system does not support it. */
+    int huge_pages;
 };
 
 /* Initialize the arena, this does not allocate anything.
@@ -116,15 +170,23 @@ struct re_arena {
 */
 RE_AA_API void re_arena_init(re_arena* a, size_t chunk_min_capacity);
 
+RE_AA_API void re_arena_options_init(re_arena_options* options);
+
+/* Same as re_arena_init with options, options can be null. */
+RE_AA_API void re_arena_init_ex(re_arena* a, size_t chunk_min_capacity, const re_arena_options* options);
+
 /* Destroy an arena. */
 RE_AA_API void re_arena_destroy(re_arena* a);
 
 /* Clear memory but does not deallocate anything. */
 RE_AA_API void re_arena_clear(re_arena* a);
 
-/* Allocate memory. */
+/* Allocate memory aligned on the natural alignment of byte_size. */
 RE_AA_API void* re_arena_alloc(re_arena* a, size_t byte_size);
 
+/* Allocate memory aligned on 'alignment', which must be a power of two. */
+RE_AA_API void* re_arena_alloc_aligned(re_arena* a, size_t byte_size, size_t alignment);
+
 /* Debug print some internal values. */
 RE_AA_API void re_arena_debug_print(re_arena* a);
 
@@ -134,6 +196,7 @@ typedef struct re_arena_state re_arena_state;
 struct re_arena_state {
     re_chunk* chunk;
     size_t size;
+    re_chunk* large;
 };
 
 /* Save where we are (int which chunk and at which position) in case we want to rollback. */
@@ -142,41 +205,121 @@ RE_AA_API void re_arena_rollback_state(re_arena* a, re_arena_state s);
 
 #endif /* RE_ARENA_ALLOC_H */
 
-#ifdef RE_AA_IMPLEMENTATION
+#if defined(RE_AA_IMPLEMENTATION) && !defined(RE_AA_IMPLEMENTATION_INCLUDED)
+#define RE_AA_IMPLEMENTATION_INCLUDED
 
 #include <string.h>
 #include <stdio.h>
 
-static re_chunk* alloc_chunk(size_t byte_size);
-static void free_chunk(re_chunk* c);
+/* Virtual memory is used by RE_AA_VIRTUAL_ALLOC and by re_arena_options.reserve_size */
+#ifdef _WIN32
+#include <windows.h>  /* VirtualAlloc */
+#else
+#include <sys/mman.h> /* mmap */
+#include <unistd.h>   /* sysconf */
+#endif
+
+static re_chunk* alloc_chunk(re_arena* a, size_t byte_size);
+static void free_chunk(re_arena* a, re_chunk* c);
 static void clear_chunk(re_chunk* c);
 
 static size_t is_power_of_two(size_t v);
 static size_t align_up(size_t v, size_t byte_alignment);
 static size_t compute_capacity_to_allocate(re_arena* a, size_t byte_size);
+static void* alloc_large(re_arena* a, size_t byte_size, size_t alignment);
+static void release_large(re_arena* a, re_chunk* until);
+static void* alloc_reserved(re_arena* a, size_t byte_size, size_t alignment);
+static void decommit_reserved(re_arena* a, size_t keep);
+static void release_reserved(re_arena* a);
+static size_t page_size(void);
+static re_chunk* alloc_huge_chunk(size_t byte_size);
+static void free_huge_chunk(re_chunk* c);
 
 RE_AA_API void
 re_arena_init(re_arena* a, size_t chunk_min_capacity)
+{
+    re_arena_init_ex(a, chunk_min_capacity, NULL);
+}
+
+RE_AA_API void
+re_arena_options_init(re_arena_options* options)
+{
+    memset(options, 0, sizeof(re_arena_options));
+}
+
+RE_AA_API void
+re_arena_init_ex(re_arena* a, size_t chunk_min_capacity, const re_arena_options* options)
 {
     RE_AA_ASSERT(is_power_of_two(chunk_min_capacity));
-    RE_AA_ASSERT(chunk_min_capacity > sizeof(re_arena));
+    RE_AA_ASSERT(chunk_min_capacity > RE_AA_SIZEOF_CHUNK_ALIGNED);
+
+    re_arena_options default_options;
+    if (!options)
+    {
+        re_arena_options_init(&default_options);
+        options = &default_options;
+    }
 
     memset(a, 0, sizeof(re_arena));
     a->chunk_min_capacity = chunk_min_capacity;
+    a->chunk_next_capacity = chunk_min_capacity;
+
+    if (options->chunk_max_capacity)
+    {
+        RE_AA_ASSERT(is_power_of_two(options->chunk_max_capacity));
+        RE_AA_ASSERT(options->chunk_max_capacity >= chunk_min_capacity);
+        a->chunk_max_capacity = options->chunk_max_capacity;
+    }
+    a->large_threshold = options->large_threshold ? options->large_threshold : (size_t)-1;
+
+    if (options->huge_pages)
+    {
+        /* Chunks are never smaller than a huge page. */
+        a->huge_pages = 1;
+        if (a->chunk_next_capacity < RE_AA_HUGE_PAGE_SIZE)
+            a->chunk_next_capacity = RE_AA_HUGE_PAGE_SIZE;
+        if (a->chunk_max_capacity && a->chunk_max_capacity < RE_AA_HUGE_PAGE_SIZE)
+            a->chunk_max_capacity = RE_AA_HUGE_PAGE_SIZE;
+    }
+
+    if (options->reserve_size)
+    {
+        /* Everything is in the reserved range, there is no large allocation. */
+        a->large_threshold = (size_t)-1;
+        a->commit_size = align_up(chunk_min_capacity, a->huge_pages ? RE_AA_HUGE_PAGE_SIZE : page_size());
+        a->reserve_size = align_up(options->reserve_size, a->commit_size);
+        a->decommit_threshold = options->decommit_threshold;
+    }
 }
 
 RE_AA_API void
 re_arena_destroy(re_arena* a)
 {
+    if (a->reserve_size)
+    {
+        release_reserved(a);
+        return;
+    }
+
     re_chunk* c = a->first;
     while (c)
     {
         re_chunk* to_free = c;
         c = c->next;
-        free_chunk(to_free);
+        free_chunk(a, to_free);
     }
     a->first = NULL;
     a->last = NULL;
+
+    release_large(a, NULL);
+    c = a->large_free;
+    while (c)
+    {
+        re_chunk* to_free = c;
+        c = c->next;
+        free_chunk(a, to_free);
+    }
+    a->large_free = NULL;
 }
 
 RE_AA_API void
@@ -190,42 +333,102 @@ re_arena_clear(re_arena* a)
     }
 
     a->last = a->first;
+    release_large(a, NULL);
+
+    if (a->decommit_threshold && a->first)
+    {
+        decommit_reserved(a, a->decommit_threshold);
+    }
+}
+
+/* Size of the chunk once byte_size bytes aligned on 'alignment' are allocated in it. */
+static size_t
+chunk_size_after(re_chunk* c, size_t byte_size, size_t alignment)
+{
+    /* The address is aligned and not the size, since the chunk itself is only aligned on RE_AA_ALIGNMENT. */
+    size_t offset = align_up((size_t)c + c->size, alignment) - (size_t)c;
+    return offset + byte_size;
 }
 
 RE_AA_API void*
 re_arena_alloc(re_arena* a, size_t byte_size)
 {
+    /* Lowest bit set of the size, a type is always aligned on a divisor of its size. */
+    size_t alignment = byte_size & (0 - byte_size);
+    if (alignment > RE_AA_ALIGNMENT || alignment == 0)
+        alignment = RE_AA_ALIGNMENT;
+
+    return re_arena_alloc_aligned(a, byte_size, alignment);
+}
+
+RE_AA_API void*
+re_arena_alloc_aligned(re_arena* a, size_t byte_size, size_t alignment)
+{
+    RE_AA_ASSERT(is_power_of_two(alignment) && "Must align to a power of two.");
+
+    if (byte_size > a->large_threshold)
+    {
+        return alloc_large(a, byte_size, alignment);
+    }
+
+    /* Fast path: there is enough space left in the last chunk. */
+    if (a->last != NULL)
+    {
+        size_t new_size = chunk_size_after(a->last, byte_size, alignment);
+        if (new_size <= a->last->capacity)
+        {
+            char* result = (char*)a->last + new_size - byte_size;
+            a->last->size = new_size;
+            return (void*)result;
+        }
+    }
+
+    if (a->reserve_size)
+    {
+        return alloc_reserved(a, byte_size, alignment);
+    }
+
+    /* Chunks are aligned on RE_AA_ALIGNMENT, more might be needed to align the memory. */
+    size_t worst_size = byte_size + (alignment > RE_AA_ALIGNMENT ? alignment - RE_AA_ALIGNMENT : 0);
+
+    /* Too big for a new chunk, it gets its own chunk and the last one keeps being filled. */
+    if (worst_size > a->chunk_next_capacity - RE_AA_SIZEOF_CHUNK_ALIGNED)
+    {
+        return alloc_large(a, byte_size, alignment);
+    }
+
     /* If there was no block allocated we allocate a new one */
     if (a->last == NULL) {
         RE_AA_ASSERT(a->first == NULL);
-        size_t to_allocate = compute_capacity_to_allocate(a, byte_size);
-        re_chunk* new_block = alloc_chunk(to_allocate);
+        size_t to_allocate = compute_capacity_to_allocate(a, worst_size);
+        re_chunk* new_block = alloc_chunk(a, to_allocate);
         a->last = new_block;
         a->first = new_block;
     }
     else
     {
         /* If we want more data than the capacity we go to the next block (if it's not the last). */
-        while (a->last->size + byte_size > a->last->capacity
+        while (chunk_size_after(a->last, byte_size, alignment) > a->last->capacity
             && a->last->next != NULL)
         {
             a->last = a->last->next;
         }
 
         /* If we reached the end and the capacity is reached. we alloc a new block */
-        if (a->last->size + byte_size > a->last->capacity)
+        if (chunk_size_after(a->last, byte_size, alignment) > a->last->capacity)
         {
             RE_AA_ASSERT(a->last->next == NULL);
-            size_t to_allocate = compute_capacity_to_allocate(a, byte_size);
-            a->last->next = alloc_chunk(to_allocate);
+            size_t to_allocate = compute_capacity_to_allocate(a, worst_size);
+            a->last->next = alloc_chunk(a, to_allocate);
             a->last = a->last->next;
         }
     }
   
     /* Retrieve the memory ptr of the last block */
-    char* result = ((char*)a->last + a->last->size);
+    size_t new_size = chunk_size_after(a->last, byte_size, alignment);
+    char* result = (char*)a->last + new_size - byte_size;
 
-    a->last->size += byte_size;
+    a->last->size = new_size;
     return (void*)result;
 }
 
@@ -236,13 +439,17 @@ re_arena_debug_print(re_arena* a)
     size_t total_size = 0;
     size_t total_capacity = 0;
 
-    re_chunk* c = a->first;
-    while (c)
+    re_chunk* lists[] = { a->first, a->large, a->large_free };
+    for (int i = 0; i < 3; ++i)
     {
-        chunk_count += 1;
-        total_size += c->size;
-        total_capacity += c->capacity;
-        c = c->next;
+        re_chunk* c = lists[i];
+        while (c)
+        {
+            chunk_count += 1;
+            total_size += c->size;
+            total_capacity += c->capacity;
+            c = c->next;
+        }
     }
 
     printf("arena: block count: %zu, total size: %zu, total capacity : %zu \n", chunk_count, total_size, total_capacity);
@@ -253,11 +460,15 @@ re_arena_allocated_chunk_count(re_arena* a)
 {
     size_t chunk_count = 0;
 
-    re_chunk* c = a->first;
-    while (c)
+    re_chunk* lists[] = { a->first, a->large, a->large_free };
+    for (int i = 0; i < 3; ++i)
     {
-        chunk_count += 1;
-        c = c->next;
+        re_chunk* c = lists[i];
+        while (c)
+        {
+            chunk_count += 1;
+            c = c->next;
+        }
     }
 
     return chunk_count;
@@ -280,6 +491,7 @@ re_arena_save_state(re_arena* a)
         state.chunk = a->last;
         state.size = a->last->size;
     }
+    state.large = a->large;
 
     return state;
 }
@@ -287,9 +499,17 @@ re_arena_save_state(re_arena* a)
 RE_AA_API void
 re_arena_rollback_state(re_arena* a, re_arena_state state)
 {
+    release_large(a, state.large);
+
     if (!state.chunk)
     {
-        re_arena_clear(a);
+        re_chunk* first = a->first;
+        while (first)
+        {
+            clear_chunk(first);
+            first = first->next;
+        }
+        a->last = a->first;
         return;
     }
 
@@ -308,9 +528,12 @@ re_arena_rollback_state(re_arena* a, re_arena_state state)
 #include "stdio.h"
 
 static re_chunk*
-alloc_chunk(size_t byte_size)
+alloc_chunk(re_arena* a, size_t byte_size)
 {
-    RE_AA_ASSERT(is_power_of_two(byte_size));
+    if (a->huge_pages)
+    {
+        return alloc_huge_chunk(byte_size);
+    }
 
     size_t alignment_offset = 0;
     char* data = NULL;
@@ -335,8 +558,8 @@ alloc_chunk(size_t byte_size)
 
 #else
 
-    /* Default malloc */
-    data = (char*)RE_AA_MALLOC(byte_size);
+    /* Default malloc, with room to align the chunk so that its whole capacity is usable. */
+    data = (char*)RE_AA_MALLOC(byte_size + RE_AA_ALIGNMENT - 1);
     if (data == NULL)
     {
         RE_AA_ASSERT(0 && "malloc failed.");
@@ -363,15 +586,21 @@ alloc_chunk(size_t byte_size)
     c->alignment_offset = alignment_offset;
     c->next = NULL;
     /* Block is instanciated within the allocated memory. So we count it as allocated memory. */
-    c->size = RE_AA_SIZEOF_CHUNK_ALIGNED + c->alignment_offset;
+    c->size = RE_AA_SIZEOF_CHUNK_ALIGNED;
     c->capacity = byte_size;
 
     return c;
 }
 
 static void
-free_chunk(re_chunk* c)
+free_chunk(re_arena* a, re_chunk* c)
 {
+    if (a->huge_pages)
+    {
+        free_huge_chunk(c);
+        return;
+    }
+
 #ifdef RE_AA_VIRTUAL_ALLOC
 #ifdef _WIN32
     if (c != NULL || c != INVALID_HANDLE_VALUE)
@@ -396,14 +625,14 @@ free_chunk(re_chunk* c)
 static void clear_chunk(re_chunk* c)
 {
     /* The size of the chunk is the initial allocated value. */
-    c->size = RE_AA_SIZEOF_CHUNK_ALIGNED + c->alignment_offset;
+    c->size = RE_AA_SIZEOF_CHUNK_ALIGNED;
 }
 
 /* Next power of two if it's not already one. */
 static size_t
 next_power_of_two(size_t x) {
     if (x <= 1) return 1;
-    int power = 2;
+    size_t power = 2;
     x--;
     while (x >>= 1) power <<= 1;
     return power;
@@ -432,16 +661,318 @@ compute_capacity_to_allocate(re_arena* a, size_t min_required_byte_size)
     min_required_byte_size += RE_AA_SIZEOF_CHUNK_ALIGNED;
 
     /* Increase capacity until it fits the allocated bytes.*/
-    size_t capacity_to_allocate = a->chunk_min_capacity;
+    size_t capacity_to_allocate = a->chunk_next_capacity;
     while (capacity_to_allocate < min_required_byte_size)
     {
         capacity_to_allocate *= 2;
     }
 
+    /* Geometric growth: the next chunk is twice as big, up to the max capacity. */
+    if (a->chunk_max_capacity && a->chunk_next_capacity < a->chunk_max_capacity)
+    {
+        a->chunk_next_capacity *= 2;
+    }
+
     capacity_to_allocate = next_power_of_two(capacity_to_allocate);
     return capacity_to_allocate;
 }
 
+static void*
+alloc_large(re_arena* a, size_t byte_size, size_t alignment)
+{
+    /* Chunks are aligned on RE_AA_ALIGNMENT, more might be needed to align the memory. */
+    size_t worst_size = byte_size + (alignment > RE_AA_ALIGNMENT ? alignment - RE_AA_ALIGNMENT : 0);
+    size_t capacity = align_up(RE_AA_SIZEOF_CHUNK_ALIGNED + worst_size, RE_AA_ALIGNMENT);
+
+    /* Reuse the smallest released chunk that fits. */
+    re_chunk** best = NULL;
+    for (re_chunk** it = &a->large_free; *it; it = &(*it)->next)
+    {
+        if ((*it)->capacity >= capacity && (!best || (*it)->capacity < (*best)->capacity))
+            best = it;
+    }
+
+    re_chunk* c = NULL;
+    if (best)
+    {
+        c = *best;
+        *best = c->next;
+    }
+    else
+    {
+        /* The chunk is not rounded up to a power of two, it's only used by this allocation. */
+        c = alloc_chunk(a, capacity);
+    }
+
+    c->next = a->large;
+    a->large = c;
+
+    size_t new_size = chunk_size_after(c, byte_size, alignment);
+    RE_AA_ASSERT(new_size <= c->capacity);
+    c->size = new_size;
+
+    return (char*)c + new_size - byte_size;
+}
+
+/* Move the large chunks used after 'until' to the list of released chunks. */
+static void
+release_large(re_arena* a, re_chunk* until)
+{
+    while (a->large && a->large != until)
+    {
+        re_chunk* c = a->large;
+        a->large = c->next;
+        clear_chunk(c);
+        c->next = a->large_free;
+        a->large_free = c;
+    }
+}
+
+static size_t
+page_size(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (size_t)info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+#ifndef _WIN32
+/* Unmap the parts of a mapping of byte_size + RE_AA_HUGE_PAGE_SIZE bytes which are outside
+   the byte_size bytes aligned on a huge page. */
+static char*
+trim_to_huge_pages(char* data, size_t byte_size)
+{
+    char* aligned = (char*)align_up((size_t)data, RE_AA_HUGE_PAGE_SIZE);
+    size_t head = (size_t)(aligned - data);
+    size_t tail = RE_AA_HUGE_PAGE_SIZE - head;
+
+    if (head)
+        munmap(data, head);
+    if (tail)
+        munmap(aligned + byte_size, tail);
+
+    return aligned;
+}
+#endif
+
+/* Map a chunk of huge pages, the capacity is rounded up to the huge page size. */
+static re_chunk*
+alloc_huge_chunk(size_t byte_size)
+{
+    char* data = NULL;
+    byte_size = align_up(byte_size, RE_AA_HUGE_PAGE_SIZE);
+
+#ifdef _WIN32
+    /* Large pages require the "Lock pages in memory" privilege, regular pages are used otherwise. */
+    size_t large_page = GetLargePageMinimum();
+    if (large_page && byte_size % large_page == 0)
+    {
+        data = (char*)VirtualAlloc(NULL, byte_size, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+    }
+    if (data == NULL)
+    {
+        data = (char*)VirtualAlloc(NULL, byte_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    }
+    if (data == NULL)
+    {
+        RE_AA_ASSERT(0 && "VirtualAlloc() failed.");
+        return NULL;
+    }
+#else
+
+#ifdef MAP_HUGETLB
+    /* Explicit huge pages, they only exist if the system reserved some (vm.nr_hugepages). */
+    data = (char*)mmap(NULL, byte_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB, -1, 0);
+    if (data == MAP_FAILED)
+        data = NULL;
+#endif
+
+    if (data == NULL)
+    {
+        /* Transparent huge pages, the range must be aligned on huge pages to be backed by them. */
+        data = (char*)mmap(NULL, byte_size + RE_AA_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (data == MAP_FAILED)
+        {
+            RE_AA_ASSERT(0 && "mmap failed.");
+            return NULL;
+        }
+
+        data = trim_to_huge_pages(data, byte_size);
+#ifdef MADV_HUGEPAGE
+        /* Hint only, it fails if transparent huge pages are disabled. */
+        madvise(data, byte_size, MADV_HUGEPAGE);
+#endif
+    }
+#endif
+
+    re_chunk* c = (re_chunk*)data;
+    c->alignment_offset = 0;
+    c->next = NULL;
+    c->size = RE_AA_SIZEOF_CHUNK_ALIGNED;
+    c->capacity = byte_size;
+
+    return c;
+}
+
+static void
+free_huge_chunk(re_chunk* c)
+{
+#ifdef _WIN32
+    if (!VirtualFree((LPVOID)c, 0, MEM_RELEASE))
+    {
+        RE_AA_ASSERT(0 && "VirtualFree() failed.");
+    }
+#else
+    int ret = munmap(c, c->capacity);
+    RE_AA_ASSERT(ret == 0);
+    (void)ret;
+#endif
+}
+
+/* Make the bytes [from, to) of the reserved range readable and writable. */
+static int
+commit_pages(char* base, size_t from, size_t to)
+{
+#ifdef _WIN32
+    if (VirtualAlloc(base + from, to - from, MEM_COMMIT, PAGE_READWRITE) == NULL)
+    {
+        RE_AA_ASSERT(0 && "VirtualAlloc() failed.");
+        return 0;
+    }
+#else
+    if (mprotect(base + from, to - from, PROT_READ | PROT_WRITE) != 0)
+    {
+        RE_AA_ASSERT(0 && "mprotect failed.");
+        return 0;
+    }
+#endif
+    return 1;
+}
+
+/* Reserve the range on first use, then commit pages until byte_size fits in the single chunk. */
+static void*
+alloc_reserved(re_arena* a, size_t byte_size, size_t alignment)
+{
+    re_chunk* c = a->first;
+
+    if (c == NULL)
+    {
+#ifdef _WIN32
+        char* data = (char*)VirtualAlloc(NULL, a->reserve_size, MEM_RESERVE, PAGE_NOACCESS);
+        if (data == NULL)
+        {
+            RE_AA_ASSERT(0 && "VirtualAlloc() failed.");
+            return NULL;
+        }
+#else
+        /* Reserve one more huge page to align the range on it. */
+        size_t extra = a->huge_pages ? RE_AA_HUGE_PAGE_SIZE : 0;
+        char* data = (char*)mmap(NULL, a->reserve_size + extra, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+        if (data == MAP_FAILED)
+        {
+            RE_AA_ASSERT(0 && "mmap failed.");
+            return NULL;
+        }
+
+        if (a->huge_pages)
+        {
+            data = trim_to_huge_pages(data, a->reserve_size);
+#ifdef MADV_HUGEPAGE
+            /* Hint only, it fails if transparent huge pages are disabled. */
+            madvise(data, a->reserve_size, MADV_HUGEPAGE);
+#endif
+        }
+#endif
+        /* The chunk header is at the start of the range, its capacity is the committed size. */
+        size_t committed = align_up(RE_AA_SIZEOF_CHUNK_ALIGNED, a->commit_size);
+        if (!commit_pages(data, 0, committed))
+            return NULL;
+
+        c = (re_chunk*)data;
+        c->next = NULL;
+        c->size = RE_AA_SIZEOF_CHUNK_ALIGNED;
+        c->capacity = committed;
+        c->alignment_offset = 0;
+        a->first = c;
+        a->last = c;
+    }
+
+    size_t new_size = chunk_size_after(c, byte_size, alignment);
+    if (new_size > c->capacity)
+    {
+        if (new_size > a->reserve_size)
+        {
+            RE_AA_ASSERT(0 && "Reserved range is full.");
+            return NULL;
+        }
+
+        size_t committed = align_up(new_size, a->commit_size);
+        if (committed > a->reserve_size)
+            committed = a->reserve_size;
+
+        if (!commit_pages((char*)c, c->capacity, committed))
+            return NULL;
+
+        c->capacity = committed;
+    }
+
+    c->size = new_size;
+    return (char*)c + new_size - byte_size;
+}
+
+/* Give back the committed pages above 'keep' bytes to the system, they are committed again when needed. */
+static void
+decommit_reserved(re_arena* a, size_t keep)
+{
+    re_chunk* c = a->first;
+    char* base = (char*)c;
+
+    keep = align_up(keep < RE_AA_SIZEOF_CHUNK_ALIGNED ? RE_AA_SIZEOF_CHUNK_ALIGNED : keep, a->commit_size);
+    if (c->capacity <= keep)
+        return;
+
+#ifdef _WIN32
+    if (!VirtualFree(base + keep, c->capacity - keep, MEM_DECOMMIT))
+    {
+        RE_AA_ASSERT(0 && "VirtualFree() failed.");
+        return;
+    }
+#else
+    /* Drop the pages first so that they are zero pages the next time they are committed. */
+    int ret = madvise(base + keep, c->capacity - keep, MADV_DONTNEED);
+    RE_AA_ASSERT(ret == 0);
+    ret = mprotect(base + keep, c->capacity - keep, PROT_NONE);
+    RE_AA_ASSERT(ret == 0);
+    (void)ret;
+#endif
+
+    c->capacity = keep;
+}
+
+static void
+release_reserved(re_arena* a)
+{
+    if (a->first)
+    {
+#ifdef _WIN32
+        if (!VirtualFree((LPVOID)a->first, 0, MEM_RELEASE))
+        {
+            RE_AA_ASSERT(0 && "VirtualFree() failed.");
+        }
+#else
+        int ret = munmap(a->first, a->reserve_size);
+        RE_AA_ASSERT(ret == 0);
+        (void)ret;
+#endif
+    }
+    a->first = NULL;
+    a->last = NULL;
+}
+
 #endif /* RE_AA_IMPLEMENTATION */
 
 /*
@@ -0,0 +1,319 @@
+/*
+
+SUMMARY:
+
+    Hash functions for hash tables: bytes, strings, integers and pointers.
+    
+    See end of file for license information.
+
+    All functions are static inline, there is no implementation to create.
+
+    Hash values are meant to be used with power of two capacities (hash & (capacity - 1)),
+    so every bit of the input affects the low bits of the hash.
+    The high bits are good too, ht.h uses them for its fingerprints and to select shards.
+
+NOTES:
+
+    Bytes are hashed with the algorithm of wyhash (final version 4, public domain, by Wang Yi):
+    inputs up to 16 bytes are read with a few overlapping loads, longer inputs are read in three
+    independent lanes of 16 bytes. This is scalar code, there is no SIMD: the lanes do not depend
+    on each other so the CPU runs their multiplications in parallel (instruction-level parallelism).
+
+    Hash values of bytes depend on the endianness of the CPU, they must not be stored and read on another platform.
+
+    FNV and other byte-at-a-time hashes are slower and their low bits are poorly mixed,
+    so keys that differ in a few bytes often land in the same buckets.
+
+    The 128-bit multiplication uses __uint128_t (GCC, Clang), _umul128 (MSVC x64) or four 64-bit multiplications otherwise.
+
+    re_hash_strv is only available if strv.h is included before this file,
+    hash.h does not require strv.h otherwise.
+
+EXAMPLE:
+
+    #include "strv.h"
+    #include "hash.h"
+
+    ht_hash_t hash_name(struct item_t* item)
+    {
+        return (ht_hash_t)re_hash_strv(item->name);
+    }
+
+    ht_hash_t hash_id(struct item_t* item)
+    {
+        return (ht_hash_t)re_hash_u64(item->id);
+    }
+*/
+
+#ifndef RE_HASH_H
+#define RE_HASH_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t, uintptr_t */
+#include <string.h> /* memcpy, strlen */
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h> /* _umul128 */
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Hash of size bytes. */
+static inline uint64_t re_hash_bytes(const void* data, size_t size);
+/* Same as re_hash_bytes with a seed, different seeds give unrelated hashes. */
+static inline uint64_t re_hash_bytes_seed(const void* data, size_t size, uint64_t seed);
+/* Hash of a null-terminated string. */
+static inline uint64_t re_hash_str(const char* str);
+#ifdef RE_STRV_H
+/* Hash of the characters of a string view. */
+static inline uint64_t re_hash_strv(strv sv);
+#endif
+/* Hash of a 32-bit integer, the result has 64 bits so it can be used by a table of any size. */
+static inline uint64_t re_hash_u32(uint32_t value);
+/* Hash of a 64-bit integer. */
+static inline uint64_t re_hash_u64(uint64_t value);
+/* Hash of a pointer address. */
+static inline uint64_t re_hash_ptr(const void* ptr);
+
+/* Secret constants of wyhash. */
+static const uint64_t re__hash_secret[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+/* Full 128-bit product of a and b, low part in a, high part in b. */
+static inline void
+re__hash_mum(uint64_t* a, uint64_t* b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t carry = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    carry += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
+
+/* Multiply and fold the high part of the product into its low part. */
+static inline uint64_t
+re__hash_mix(uint64_t a, uint64_t b)
+{
+    re__hash_mum(&a, &b);
+    return a ^ b;
+}
+
+/* Unaligned reads, memcpy is turned into a single load by compilers. */
+static inline uint64_t
+re__hash_read8(const unsigned char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t
+re__hash_read4(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/* 1 to 3 bytes, the first, middle and last bytes. */
+static inline uint64_t
+re__hash_read3(const unsigned char* p, size_t size)
+{
+    return (((uint64_t)p[0]) << 16) | (((uint64_t)p[size >> 1]) << 8) | p[size - 1];
+}
+
+static inline uint64_t
+re_hash_bytes_seed(const void* data, size_t size, uint64_t seed)
+{
+    const uint64_t* secret = re__hash_secret;
+    const unsigned char* p = (const unsigned char*)data;
+    uint64_t a, b;
+
+    seed ^= re__hash_mix(seed ^ secret[0], secret[1]);
+
+    if (size <= 16)
+    {
+        if (size >= 4)
+        {
+            /* Two overlapping pairs of 4 bytes cover 4 to 16 bytes. */
+            size_t middle = (size >> 3) << 2;
+            a = (re__hash_read4(p) << 32) | re__hash_read4(p + middle);
+            b = (re__hash_read4(p + size - 4) << 32) | re__hash_read4(p + size - 4 - middle);
+        }
+        else if (size > 0)
+        {
+            a = re__hash_read3(p, size);
+            b = 0;
+        }
+        else
+        {
+            a = b = 0;
+        }
+    }
+    else
+    {
+        size_t i = size;
+        if (i >= 48)
+        {
+            /* Three independent streams. */
+            uint64_t seed1 = seed, seed2 = seed;
+            do
+            {
+                seed = re__hash_mix(re__hash_read8(p) ^ secret[1], re__hash_read8(p + 8) ^ seed);
+                seed1 = re__hash_mix(re__hash_read8(p + 16) ^ secret[2], re__hash_read8(p + 24) ^ seed1);
+                seed2 = re__hash_mix(re__hash_read8(p + 32) ^ secret[3], re__hash_read8(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i >= 48);
+            seed ^= seed1 ^ seed2;
+        }
+
+        while (i > 16)
+        {
+            seed = re__hash_mix(re__hash_read8(p) ^ secret[1], re__hash_read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+
+        /* Last 16 bytes, they can overlap the previous ones. */
+        a = re__hash_read8(p + i - 16);
+        b = re__hash_read8(p + i - 8);
+    }
+
+    a ^= secret[1];
+    b ^= seed;
+    re__hash_mum(&a, &b);
+
+    return re__hash_mix(a ^ secret[0] ^ (uint64_t)size, b ^ secret[1]);
+}
+
+static inline uint64_t
+re_hash_bytes(const void* data, size_t size)
+{
+    return re_hash_bytes_seed(data, size, 0);
+}
+
+static inline uint64_t
+re_hash_str(const char* str)
+{
+    return re_hash_bytes_seed(str, strlen(str), 0);
+}
+
+#ifdef RE_STRV_H
+static inline uint64_t
+re_hash_strv(strv sv)
+{
+    return re_hash_bytes_seed(sv.data, sv.size, 0);
+}
+#endif
+
+static inline uint64_t
+re_hash_u32(uint32_t value)
+{
+    /* One multiplication is enough for 32 bits: the high half of the 64-bit product
+       depends on every bit of the value and is folded into the low half. */
+    uint64_t x = (uint64_t)value * 0x9e3779b97f4a7c15ull;
+    return x ^ (x >> 32);
+}
+
+static inline uint64_t
+re_hash_u64(uint64_t value)
+{
+    /* Finalizer of splitmix64. */
+    uint64_t x = value;
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+static inline uint64_t
+re_hash_ptr(const void* ptr)
+{
+    /* The lowest 4 bits are usually 0 because of the alignment, they are rotated to the top
+       so that the low bits of the first product only depend on bits that vary.
+       Addresses often differ only by a small stride, a second multiplication is needed to spread them in the low bits. */
+    uint64_t x = (uint64_t)(uintptr_t)ptr;
+    x = (x >> 4) | (x << 60);
+    x *= 0x9e3779b97f4a7c15ull;
+    x ^= x >> 32;
+    x *= 0xbf58476d1ce4e5b9ull;
+    return x ^ (x >> 29);
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* RE_HASH_H */
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE 1 - The MIT License (MIT)
+
+Copyright (c) 2024 kevreco
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE 2 - Public Domain (www.unlicense.org)
+
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <https://unlicense.org>
+------------------------------------------------------------------------------
+*/
\ No newline at end of file
@@ -18,6 +18,32 @@ NOTES:
     Assert can be redefined with:
         #define HT_ASSERT(x) my_assert(x)
 
+    malloc, realloc and free can be redefined with:
+        #define HT_MALLOC(x) my_malloc(x)
+        #define HT_REALLOC(x, size) my_realloc(x, size)
+        #define HT_FREE(x) my_free(x)
+    or replaced for a single table with ht_options.allocator.
+
+    The hashes can be stored in their own dense array instead of in front of each item,
+    see ht_options.separate_metadata and ht_init_ex.
+
+    A dense array of control bytes (one fingerprint per bucket) is used to probe
+    16 (SSE2) or 32 (AVX2) buckets at once, selected at compile time.
+    The distance of each item from its ideal bucket is cached in another dense array of bytes.
+    SIMD can be disabled with:
+        #define HT_NO_SIMD
+
+    Number of buckets moved at each insert or erase when ht_options.incremental_resize is used:
+        #define HT_INCREMENTAL_STEP 8
+
+    Number of keys hashed and prefetched before being looked up by ht_get_items_batch:
+        #define HT_BATCH_SIZE 16
+
+    The max load, the growth factor and the min capacity can be changed per table with ht_options.
+
+    Number of entries of the histogram of distances filled by ht_stats:
+        #define HT_STATS_HISTOGRAM_SIZE 16
+
 EXAMPLE:
 
     #define HT_IMPLEMENTATION
@@ -78,6 +104,7 @@ EXAMPLE:
 
 #include <stddef.h> /* size_t */
 #include <stdint.h> /* intptr_t */
+#include <string.h> /* memset */
 
 /* Hash Table */
 
@@ -104,10 +131,23 @@ EXAMPLE:
 #define HT_FREE free
 #endif
 
+#ifndef HT_REALLOC
+#include <stdlib.h>
+#define HT_REALLOC realloc
+#endif
+
 #ifndef HT_SIZE_T
 #define HT_SIZE_T size_t
 #endif
 
+#ifndef HT_INCREMENTAL_STEP
+#define HT_INCREMENTAL_STEP 8
+#endif
+
+#ifndef HT_BATCH_SIZE
+#define HT_BATCH_SIZE 16
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -123,32 +163,138 @@ typedef ht_bool (*ht_predicate_t)(void* left, void* right);
 typedef void (*ht_swap_function_t)(void* left, void* right);
 typedef ht_hash_t (*ht_hash_function_t)(void* item);
 
+/* Used to find an item from a key only, see ht_get_item_by_key. */
+typedef ht_hash_t (*ht_key_hash_function_t)(void* key);
+typedef ht_bool (*ht_key_predicate_t)(void* item, void* key);
+
+typedef void* (*ht_alloc_function_t)(void* context, ht_size_t size);
+typedef void* (*ht_realloc_function_t)(void* context, void* ptr, ht_size_t old_size, ht_size_t new_size);
+typedef void (*ht_free_function_t)(void* context, void* ptr, ht_size_t size);
+
+/* Memory used by a table, see ht_options.allocator. */
+typedef struct ht_allocator ht_allocator;
+struct ht_allocator {
+    ht_alloc_function_t allocate;     /* null to use HT_MALLOC, HT_REALLOC and HT_FREE */
+    ht_realloc_function_t reallocate; /* optional, memory is allocated and copied otherwise */
+    ht_free_function_t deallocate;    /* optional, memory is never released otherwise (in an arena for instance) */
+    void* context;                    /* given to each function */
+};
+
 typedef struct ht ht;
 
 struct ht {
     ht_byte_t* buckets;
+    ht_byte_t* hashes;         /* hash of each bucket, points inside 'buckets' unless the metadata is separated */
+    unsigned char* ctrl;       /* control byte of each bucket: 0 if empty, fingerprint of the hash otherwise */
+    unsigned char* distances;  /* distance of each item from its ideal bucket, saturated to 255 */
 
     ht_size_t bucket_capacity; /* count of bucket in the array */
     
     ht_size_t sizeof_item;
-    ht_size_t sizeof_bucket;   /* size of item + bucket header */
+    ht_size_t sizeof_bucket;   /* size of item + bucket header (if any) */
+    ht_size_t hash_stride;     /* distance in bytes between two consecutive hashes */
+    ht_size_t item_offset;     /* offset of the item within its bucket */
+
+    ht_bool separate_metadata;
 
     ht_hash_function_t hash;
     ht_predicate_t items_are_same;
     ht_swap_function_t swap_items;
 
     ht_size_t filled_bucket_count;  /* number of filled entries */
-    ht_size_t allocated_memory;     /* allocated memory for all the buckets and the temp entries below */
+    ht_size_t grow_threshold;       /* max number of filled entries before growing, derived from max_load */
+    ht_size_t shrink_threshold;     /* number of filled entries below which erasing shrinks the table, derived from min_load */
+    float max_load;
+    float min_load;
+    ht_size_t growth_factor;        /* power of two */
+    ht_size_t min_capacity;         /* capacity when growing from an empty table */
+    ht_allocator allocator;
+    ht_size_t max_distance;         /* upper bound of the distances of all items, lookups never probe further */
+    ht_size_t allocated_memory;     /* allocated memory for all the buckets, the control bytes and the temp entries below */
+    ht_size_t grow_count;           /* number of times the buckets were replaced by bigger ones, see ht_stats */
+    ht_size_t shrink_count;         /* number of times the buckets were replaced by smaller ones, see ht_stats */
 
     void* tmp_entry;
     void* tmp_for_swap;
+
+    ht_bool incremental_resize;
+    ht* migrating;             /* table whose items are being moved into this one, see ht_options.incremental_resize */
+    ht_size_t migration_index; /* next bucket of 'migrating' to move */
+};
+
+/* Optional settings provided to ht_init_ex. */
+typedef struct ht_options ht_options;
+struct ht_options {
+    /* Store the hashes in their own dense array instead of in front of each item.
+       Probing then only touches the items when hashes are matching,
+       which is faster for big items but requires one more cache line for small ones. */
+    ht_bool separate_metadata;
+
+    /* Grow by moving a few buckets at each insert or erase instead of moving all items at once.
+       Old and new buckets are kept side by side until all items are moved, lookups check both of them.
+       Only writes advance the migration: lookups take a const table (which ht_concurrent readers rely on)
+       and never move buckets, so a table that is mostly read keeps both arrays and probes both of them.
+       Iterating with a cursor, ht_reserve and ht_shrink_to_fit move all remaining items first,
+       call one of them after a burst of inserts if the table is then only read. */
+    ht_bool incremental_resize;
+
+    /* Ratio of filled buckets above which the table grows, between 0 and 1 (exclusive).
+       Lower is faster to probe, higher uses less memory. 0 means the default (0.75). */
+    float max_load;
+
+    /* Ratio of filled buckets below which erasing an item halves the capacity, 0 (the default) to never shrink.
+       Must be lower than half of max_load so that a table does not grow again right after shrinking.
+       Only ht_erase and ht_erase_key shrink the table, erasing with an index or a cursor does not. */
+    float min_load;
+
+    /* Multiplier of the capacity when growing, rounded up to a power of two. 0 means the default (2). */
+    ht_size_t growth_factor;
+
+    /* Capacity of the first allocation when inserting in an empty table. 0 means the default (16). */
+    ht_size_t min_capacity;
+
+    /* Functions used to allocate the buckets, HT_MALLOC, HT_REALLOC and HT_FREE are used if 'allocate' is null.
+       The size of the memory is given when it's released so that it can come from mmap or a pool. */
+    ht_allocator allocator;
+};
+
+#ifndef HT_STATS_HISTOGRAM_SIZE
+#define HT_STATS_HISTOGRAM_SIZE 16
+#endif
+
+/* Measures of a table filled by ht_stats. */
+typedef struct ht_statistics ht_statistics;
+struct ht_statistics {
+    ht_size_t item_count;
+    ht_size_t bucket_capacity;
+    float load_factor;            /* item_count / bucket_capacity */
+
+    /* Distance of the items from their ideal bucket, a lookup of an existing item probes distance + 1 buckets.
+       The mean stays below 1 with a good hash function, a high max distance means items share the same buckets. */
+    float mean_distance;
+    ht_size_t max_distance;
+    ht_size_t distance_histogram[HT_STATS_HISTOGRAM_SIZE]; /* number of items for each distance, the last entry counts further ones too */
+
+    /* Runs of consecutive filled buckets, a lookup of a missing item probes up to the end of the run. */
+    ht_size_t cluster_count;
+    ht_size_t max_cluster_size;
+    float mean_cluster_size;
+
+    ht_size_t allocated_memory;   /* same as ht_allocated_memory */
+    float bytes_per_item;         /* allocated_memory / item_count, 0 if there is no item */
+
+    ht_size_t grow_count;         /* number of times the buckets were replaced by bigger ones, the first allocation excluded */
+    ht_size_t shrink_count;       /* number of times the buckets were replaced by smaller ones */
 };
 
 /* use to iterate over all items */
 typedef struct ht_cursor ht_cursor;
 struct ht_cursor {
     void* current_bucket; /* pointer of current bucket */
-    const ht* h;
+    ht_size_t index;      /* index of current bucket */
+    ht* h;
+    ht_size_t start;      /* index of the first visited bucket, which follows an empty bucket */
+    ht_size_t position;   /* number of buckets visited from 'start' */
 };
 
 HT_API void ht_init(ht* h,
@@ -158,8 +304,22 @@ HT_API void ht_init(ht* h,
     ht_swap_function_t swap_items,
     ht_size_t initial_capacity);
 
+/* Set default options. */
+HT_API void ht_options_init(ht_options* options);
+
+/* Same as ht_init but with custom options, options can be null. */
+HT_API void ht_init_ex(ht* h,
+    ht_size_t sizeof_item,
+    ht_hash_function_t hash,
+    ht_predicate_t items_are_same,
+    ht_swap_function_t swap_items,
+    ht_size_t initial_capacity,
+    const ht_options* options);
+
 HT_API void ht_destroy(ht* h);
 HT_API void ht_reserve(ht* h, ht_size_t item_count);
+/* Reduce the capacity to the smallest one able to hold the current items, the memory is released if there is no item. */
+HT_API void ht_shrink_to_fit(ht* h);
 HT_API void ht_clear(ht* h);
 HT_API void ht_swap(ht* h, ht* other);
 
@@ -176,6 +336,21 @@ HT_API ht_bool ht_insert(ht* h, void* item);
 /* Same as ht_insert but explicitly provide the hash value. */
 HT_API ht_bool ht_insert_h(ht* h, void* item, ht_hash_t hash);
 
+/* Returns the item matching 'item' if it exists, otherwise 'item' is inserted and the new item is returned.
+   The lookup and the insertion share the same probing. The returned item can be modified in place
+   (except its key) and is valid until the next insert or erase.
+   was_inserted is optional, it's set to true if 'item' was inserted. */
+HT_API void* ht_find_or_insert(ht* h, void* item, ht_bool* was_inserted);
+/* Same as ht_find_or_insert but explicitly provide the hash value. */
+HT_API void* ht_find_or_insert_h(ht* h, void* item, ht_hash_t hash, ht_bool* was_inserted);
+
+/* Insert 'count' contiguous items, the table grows at most once.
+   Returns the number of items inserted, replaced items are not counted. */
+HT_API ht_size_t ht_insert_many(ht* h, const void* items, ht_size_t count);
+/* Same as ht_insert_many but items are placed in the order of their ideal bucket, so buckets are written in memory order.
+   This is faster for big tables, a temporary array of 'count' hashes and indices is allocated. */
+HT_API ht_size_t ht_insert_many_sorted(ht* h, const void* items, ht_size_t count);
+
 /* Returns true if item was found according to items_are_same. */
 HT_API ht_bool ht_contains(const ht* h, void* item);
 /* Same as ht_inht_contains but explicitly provide the hash value. */
@@ -186,6 +361,14 @@ HT_API void* ht_get_item(const ht* h, void* item);
 /* Same as ht_get_item but explicitly provide the hash value. */
 HT_API void* ht_get_item_h(const ht* h, void* item, ht_hash_t hash);
 
+/* Look up 'count' keys at once, the nth key is at 'keys + n * stride'.
+   out_items[n] receives the item matching the nth key, or null if it was not found.
+   All keys of a batch are hashed and their buckets are prefetched before being compared,
+   so the cache misses of the keys overlap instead of being waited one after the other. */
+HT_API void ht_get_items_batch(const ht* h, const void* keys, ht_size_t count, ht_size_t stride, void** out_items);
+/* Same as ht_get_items_batch but explicitly provide the hash value of each key. */
+HT_API void ht_get_items_batch_h(const ht* h, const void* keys, const ht_hash_t* hashes, ht_size_t count, ht_size_t stride, void** out_items);
+
 /* Get a copy of the item if it has been found copy the data in result, returns true if item was found */
 HT_API ht_bool ht_get(const ht* h, void* item, void* result);
 /* Same as ht_get but explicitly provide the hash value. */
@@ -196,142 +379,427 @@ HT_API ht_bool ht_erase(ht* h, void* item);
 /* Same as ht_erase but explicitly provide the hash value. */
 HT_API ht_bool ht_erase_h(ht* h, void* item, ht_hash_t hash);
 
+/* Lookups from a key instead of a full item, the key is never copied.
+   'key_hash' must return the same hash as the hash function of the table for an item with the same key,
+   'item_has_key' returns true if the item of the table has the key. */
+HT_API void* ht_get_item_by_key(const ht* h, void* key, ht_key_hash_function_t key_hash, ht_key_predicate_t item_has_key);
+HT_API ht_bool ht_contains_key(const ht* h, void* key, ht_key_hash_function_t key_hash, ht_key_predicate_t item_has_key);
+HT_API ht_bool ht_erase_key(ht* h, void* key, ht_key_hash_function_t key_hash, ht_key_predicate_t item_has_key);
+/* Same as above but explicitly provide the hash value. */
+HT_API void* ht_get_item_by_key_h(const ht* h, void* key, ht_hash_t hash, ht_key_predicate_t item_has_key);
+HT_API ht_bool ht_contains_key_h(const ht* h, void* key, ht_hash_t hash, ht_key_predicate_t item_has_key);
+HT_API ht_bool ht_erase_key_h(ht* h, void* key, ht_hash_t hash, ht_key_predicate_t item_has_key);
+
+/* Delete the item of the bucket at index. */
+HT_API void ht_erase_at(ht* h, ht_size_t index);
+
 HT_API void ht_cursor_init(ht* h, ht_cursor* cursor);
 /* Go to next bucket and return point to it */
 HT_API void* ht_cursor_next(ht_cursor* cursor);
 HT_API void* ht_cursor_end(const ht_cursor* cursor);
 HT_API void* ht_cursor_item(const ht_cursor* cursor);
+/* Delete the current item, the next call to ht_cursor_next gives the following item.
+   This is the only way to delete items while iterating, remaining items are still visited exactly once. */
+HT_API void ht_cursor_erase(ht_cursor* cursor);
 
 HT_API ht_size_t ht_allocated_memory(const ht* h);
 
+/* Fill 'out' with the load, the probe distances, the clusters and the memory use of the table.
+   All buckets are visited, it's meant for diagnostics and metrics, not to be called at each operation. */
+HT_API void ht_stats(const ht* h, ht_statistics* out);
+
 HT_API void ht_debug_print_info(ht* h);
 
+/* Generate a type-specific hash table using the same Robin Hood hashing as 'ht'.
+   The hash and equality are called directly (so they can be inlined) and entries are copied by value.
+   HASH_FN must be callable as 'ht_hash_t HASH_FN(KEY_TYPE key)'
+   EQ_FN must be callable as 'ht_bool EQ_FN(KEY_TYPE left, KEY_TYPE right)'
+   Usage:
+       HT_DEFINE(int_map, int, float, hash_int, ints_are_same)
+       int_map m;
+       int_map_init(&m);
+       int_map_insert(&m, 1, 3.14f);
+       float* value = int_map_get(&m, 1);
+       int_map_destroy(&m);
+   Items can be iterated by looking at each entry of 'entries' for which 'hashes' is not 0. */
+#define HT_DEFINE(NAME, KEY_TYPE, VALUE_TYPE, HASH_FN, EQ_FN)                                                          \
+typedef struct NAME ## _entry NAME ## _entry;                                                                          \
+struct NAME ## _entry {                                                                                                \
+    KEY_TYPE key;                                                                                                      \
+    VALUE_TYPE value;                                                                                                  \
+};                                                                                                                     \
+typedef struct NAME NAME;                                                                                              \
+struct NAME {                                                                                                          \
+    ht_hash_t* hashes; /* 0 for empty buckets */                                                                       \
+    NAME ## _entry* entries;                                                                                           \
+    ht_size_t capacity;                                                                                                \
+    ht_size_t size;                                                                                                    \
+};                                                                                                                     \
+static inline void NAME ## _init(NAME* h)                                                                              \
+{                                                                                                                      \
+    memset(h, 0, sizeof(NAME));                                                                                        \
+}                                                                                                                      \
+static inline void NAME ## _destroy(NAME* h)                                                                           \
+{                                                                                                                      \
+    if (h->hashes) HT_FREE(h->hashes);                                                                                 \
+    if (h->entries) HT_FREE(h->entries);                                                                               \
+    memset(h, 0, sizeof(NAME));                                                                                        \
+}                                                                                                                      \
+static inline void NAME ## _clear(NAME* h)                                                                             \
+{                                                                                                                      \
+    if (h->hashes) memset(h->hashes, 0, h->capacity * sizeof(ht_hash_t));                                              \
+    h->size = 0;                                                                                                       \
+}                                                                                                                      \
+static inline ht_size_t NAME ## _size(const NAME* h)                                                                   \
+{                                                                                                                      \
+    return h->size;                                                                                                    \
+}                                                                                                                      \
+static inline ht_hash_t NAME ## __hash(KEY_TYPE key)                                                                   \
+{                                                                                                                      \
+    ht_hash_t hash = HASH_FN(key);                                                                                     \
+    return hash == 0 ? 1 : hash; /* 0 is reserved for empty buckets */                                                 \
+}                                                                                                                      \
+/* Place an entry that is not in the table yet, starting at 'index' which is 'distance' away from its ideal bucket. */ \
+static inline void NAME ## __place(NAME* h, ht_size_t index, ht_size_t distance, ht_hash_t hash, NAME ## _entry entry) \
+{                                                                                                                      \
+    ht_size_t mask = h->capacity - 1;                                                                                  \
+    for (;;)                                                                                                           \
+    {                                                                                                                  \
+        ht_hash_t current_hash = h->hashes[index];                                                                     \
+        if (current_hash == 0)                                                                                         \
+        {                                                                                                              \
+            h->hashes[index] = hash;                                                                                   \
+            h->entries[index] = entry;                                                                                 \
+            return;                                                                                                    \
+        }                                                                                                              \
+        ht_size_t current_distance = (index - current_hash) & mask;                                                    \
+        if (current_distance < distance)                                                                               \
+        {                                                                                                              \
+            NAME ## _entry displaced = h->entries[index];                                                              \
+            h->hashes[index] = hash;                                                                                   \
+            h->entries[index] = entry;                                                                                 \
+            hash = current_hash;                                                                                       \
+            entry = displaced;                                                                                         \
+            distance = current_distance;                                                                               \
+        }                                                                                                              \
+        index = (index + 1) & mask;                                                                                    \
+        distance += 1;                                                                                                 \
+    }                                                                                                                  \
+}                                                                                                                      \
+/* Reserve at least 'capacity' buckets. */                                                                             \
+static inline void NAME ## _reserve(NAME* h, ht_size_t capacity)                                                       \
+{                                                                                                                      \
+    ht_size_t new_capacity = 16;                                                                                       \
+    while (new_capacity < capacity) new_capacity *= 2;                                                                 \
+    if (new_capacity <= h->capacity) return;                                                                           \
+    NAME old = *h;                                                                                                     \
+    h->hashes = (ht_hash_t*)HT_MALLOC(new_capacity * sizeof(ht_hash_t));                                               \
+    h->entries = (NAME ## _entry*)HT_MALLOC(new_capacity * sizeof(NAME ## _entry));                                    \
+    h->capacity = new_capacity;                                                                                        \
+    memset(h->hashes, 0, new_capacity * sizeof(ht_hash_t));                                                            \
+    for (ht_size_t i = 0; i < old.capacity; ++i)                                                                       \
+    {                                                                                                                  \
+        /* Stored hashes are reused, the hash function is not called. */                                               \
+        if (old.hashes[i]) NAME ## __place(h, old.hashes[i] & (new_capacity - 1), 0, old.hashes[i], old.entries[i]);   \
+    }                                                                                                                  \
+    if (old.hashes) HT_FREE(old.hashes);                                                                               \
+    if (old.entries) HT_FREE(old.entries);                                                                             \
+}                                                                                                                      \
+static inline ht_bool NAME ## __find(const NAME* h, KEY_TYPE key, ht_hash_t hash, ht_size_t* index)                    \
+{                                                                                                                      \
+    if (h->size == 0) return 0;                                                                                        \
+    ht_size_t mask = h->capacity - 1;                                                                                  \
+    ht_size_t i = hash & mask;                                                                                         \
+    for (ht_size_t distance = 0;; ++distance)                                                                          \
+    {                                                                                                                  \
+        ht_hash_t current_hash = h->hashes[i];                                                                         \
+        if (current_hash == 0) return 0;                                                                               \
+        if (current_hash == hash && EQ_FN(h->entries[i].key, key))                                                     \
+        {                                                                                                              \
+            *index = i;                                                                                                \
+            return 1;                                                                                                  \
+        }                                                                                                              \
+        if (((i - current_hash) & mask) < distance) return 0;                                                          \
+        i = (i + 1) & mask;                                                                                            \
+    }                                                                                                                  \
+}                                                                                                                      \
+/* Returns a pointer to the value, null if the key was not found. */                                                   \
+static inline VALUE_TYPE* NAME ## _get(const NAME* h, KEY_TYPE key)                                                    \
+{                                                                                                                      \
+    ht_size_t index;                                                                                                   \
+    return NAME ## __find(h, key, NAME ## __hash(key), &index) ? &h->entries[index].value : 0;                         \
+}                                                                                                                      \
+static inline ht_bool NAME ## _contains(const NAME* h, KEY_TYPE key)                                                   \
+{                                                                                                                      \
+    ht_size_t index;                                                                                                   \
+    return NAME ## __find(h, key, NAME ## __hash(key), &index);                                                        \
+}                                                                                                                      \
+/* Returns true if the key was inserted, false if the value was replaced. */                                           \
+static inline ht_bool NAME ## _insert(NAME* h, KEY_TYPE key, VALUE_TYPE value)                                         \
+{                                                                                                                      \
+    if ((h->size + 1) * 4 > h->capacity * 3)                                                                           \
+        NAME ## _reserve(h, h->capacity * 2);                                                                          \
+    ht_hash_t hash = NAME ## __hash(key);                                                                              \
+    ht_size_t mask = h->capacity - 1;                                                                                  \
+    ht_size_t i = hash & mask;                                                                                         \
+    for (ht_size_t distance = 0;; ++distance)                                                                          \
+    {                                                                                                                  \
+        ht_hash_t current_hash = h->hashes[i];                                                                         \
+        if (current_hash == 0 || ((i - current_hash) & mask) < distance)                                               \
+        {                                                                                                              \
+            NAME ## _entry entry;                                                                                      \
+            entry.key = key;                                                                                           \
+            entry.value = value;                                                                                       \
+            NAME ## __place(h, i, distance, hash, entry);                                                              \
+            h->size += 1;                                                                                              \
+            return 1;                                                                                                  \
+        }                                                                                                              \
+        if (current_hash == hash && EQ_FN(h->entries[i].key, key))                                                     \
+        {                                                                                                              \
+            h->entries[i].value = value;                                                                               \
+            return 0;                                                                                                  \
+        }                                                                                                              \
+        i = (i + 1) & mask;                                                                                            \
+    }                                                                                                                  \
+}                                                                                                                      \
+/* Returns true if the key was erased. */                                                                              \
+static inline ht_bool NAME ## _erase(NAME* h, KEY_TYPE key)                                                            \
+{                                                                                                                      \
+    ht_size_t i;                                                                                                       \
+    if (!NAME ## __find(h, key, NAME ## __hash(key), &i)) return 0;                                                    \
+    ht_size_t mask = h->capacity - 1;                                                                                  \
+    for (;;)                                                                                                           \
+    {                                                                                                                  \
+        ht_size_t next = (i + 1) & mask;                                                                               \
+        ht_hash_t next_hash = h->hashes[next];                                                                         \
+        if (next_hash == 0 || ((next - next_hash) & mask) == 0) break;                                                 \
+        h->hashes[i] = next_hash;                                                                                      \
+        h->entries[i] = h->entries[next];                                                                              \
+        i = next;                                                                                                      \
+    }                                                                                                                  \
+    h->hashes[i] = 0;                                                                                                  \
+    h->size -= 1;                                                                                                      \
+    return 1;                                                                                                          \
+}
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
 
 #endif /* RE_HT_H */
 
-#if defined(HT_IMPLEMENTATION)
+/* The implementation is only included once, ht.h can then be included again by ht_ptr.h and others. */
+#if defined(HT_IMPLEMENTATION) && !defined(RE_HT_IMPLEMENTATION)
+#define RE_HT_IMPLEMENTATION
+
+#include <string.h> /* memcpy, memset */
+#include <stdio.h>  /* printf */
 
-#define ht_each_bucket(ht_ptr, bucket_ptr) \
-    (bucket_ptr) = ht__bucket_begin(ht_ptr); (bucket_ptr) < ht__bucket_end(ht_ptr); (bucket_ptr) = ht__bucket_next(ht_ptr, bucket_ptr)
+#define ht_each_bucket_index(ht_ptr, index) \
+    (index) = 0; (index) < (ht_ptr)->bucket_capacity; ++(index)
 
-static const ht_size_t MIN_CAPACITY = 16;
-static double MAX_LOAD = 0.75;
+static const ht_size_t DEFAULT_MIN_CAPACITY = 16;
+static const float DEFAULT_MAX_LOAD = 0.75f;
+static const ht_size_t DEFAULT_GROWTH_FACTOR = 2;
 
 static const ht_hash_t RESERVED_HASH_FOR_EMPTY = (ht_hash_t)0;
 
-/* For simplicity we just call the 'bucket header' 'bucket'. */
+/* Cached distances greater or equal to this value are computed from the hash. */
+static const unsigned char DISTANCE_OVERFLOW = 255;
+
+/* Number of control bytes compared at once, 0 if SIMD is not available. */
+#if !defined(HT_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define HT_GROUP_WIDTH 32
+#elif !defined(HT_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define HT_GROUP_WIDTH 16
+#else
+#define HT_GROUP_WIDTH 0
+#endif
+
+#if HT_GROUP_WIDTH && defined(_MSC_VER)
+#include <intrin.h> /* _BitScanForward */
+#endif
+
+/* Hint to load a cache line ahead of its use. */
+#if defined(__GNUC__) || defined(__clang__)
+#define HT_PREFETCH(addr) __builtin_prefetch(addr)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#define HT_PREFETCH(addr) _mm_prefetch((const char*)(addr), _MM_HINT_T0)
+#else
+#define HT_PREFETCH(addr) ((void)(addr))
+#endif
+
+/* Header prepended to each item when the metadata is not separated.
+   For simplicity we just call the 'bucket header' 'bucket'. */
 typedef struct bucket_t bucket_t;
 struct bucket_t {
     ht_hash_t hash;
 };
 
-static struct
-bucket_t* ht__bucket_begin(const ht* h)
+static ht_hash_t
+ht__adjust_hash(ht_hash_t hash)
 {
-    return (bucket_t*)h->buckets;
+    /* Adjust hash if it's a reserved hash */
+    if (hash == RESERVED_HASH_FOR_EMPTY)
+    {
+        hash = RESERVED_HASH_FOR_EMPTY == 0 ? hash + 1 : hash - 1;
+    }
+    return hash;
 }
 
-static struct
-bucket_t* ht__bucket_end(const ht* h)
+static ht_hash_t
+ht__do_hash(const ht* h, const void* item)
 {
-    return (bucket_t*)(h->buckets + (h->bucket_capacity * h->sizeof_bucket));
+    return ht__adjust_hash(h->hash((void*)item));
 }
 
-static struct
-bucket_t* ht__bucket_next(const ht* h, bucket_t* bucket)
+static inline ht_byte_t*
+ht__bucket_at(const ht* h, ht_size_t index)
 {
-    return (bucket_t*) ((char*)bucket + h->sizeof_bucket);
+    return h->buckets + (index * h->sizeof_bucket);
 }
 
-static ht_hash_t
-ht__do_hash(const ht* h, const void* item)
+/* Both layouts are handled with strides so there is no branching when a bucket is accessed:
+   - inline metadata:   hashes == buckets, hash_stride == sizeof_bucket, item_offset == sizeof(bucket_t)
+   - separate metadata: hashes is a dense array, hash_stride == sizeof(ht_hash_t), item_offset == 0 */
+static inline ht_hash_t*
+ht__hash_at(const ht* h, ht_size_t index)
 {
-    ht_hash_t hash = h->hash((void*)item);
+    return (ht_hash_t*)(h->hashes + (index * h->hash_stride));
+}
 
-    /* Adjust hash if it's a reserved hash */
-    if (hash == RESERVED_HASH_FOR_EMPTY)
-    {
-        hash = RESERVED_HASH_FOR_EMPTY == 0 ? hash + 1 : hash - 1;
-    }
-    return hash;
+static inline void*
+ht__item_at(const ht* h, ht_size_t index)
+{
+    return ht__bucket_at(h, index) + h->item_offset;
 }
 
-static inline bucket_t*
-ht__bucket_at(const ht* h, ht_size_t index)
+static inline ht_size_t
+ht__bucket_index(const ht* h, ht_hash_t hash)
 {
-    return (bucket_t*)(h->buckets + (index * h->sizeof_bucket));
+    /* Equivalent to hash% h->bucket_capacity but faster since we are using power of two as bucket capacity. */
+    return hash & (h->bucket_capacity - 1);
 }
 
-static inline ht_bool
-ht__bucket_is_empty(const bucket_t* bucket)
+static inline
+ht_size_t ht__bucket_distance(const ht* h, ht_size_t first, ht_size_t last)
 {
-    return bucket->hash == RESERVED_HASH_FOR_EMPTY;
+    /* get distance and "wrap it" to fit inside the bucket indices. */
+    return ht__bucket_index(h, first - last);
 }
 
-static ht_bool
-ht__bucket_is_empty_at(ht* h, ht_size_t index)
+/* Top 7 bits of the hash with the high bit set so that it's never 0 (0 is for empty buckets).
+   The low bits are already used to compute the bucket index. */
+static inline unsigned char
+ht__fingerprint(ht_hash_t hash)
 {
-    bucket_t* bucket = ht__bucket_at(h, index);
-    return ht__bucket_is_empty(bucket);
+    return (unsigned char)((hash >> (sizeof(ht_hash_t) * 8 - 7)) | 0x80);
 }
 
-static void*
-ht__get_bucket_item(bucket_t* bucket)
+/* Tables split in several shards (ht_sharded.h, ht_concurrent.h) route a hash with the high bits right below the fingerprint,
+   so that the fingerprints of a shard are not all the same. shard_count must be a power of two. */
+static inline unsigned int
+ht__shard_shift(ht_size_t shard_count)
 {
-    return (char*)bucket + sizeof(bucket_t);
+    unsigned int shift = sizeof(ht_hash_t) * 8 - 7;
+    for (ht_size_t n = shard_count; n > 1; n >>= 1)
+        shift -= 1;
+    return shift;
 }
 
-static void
-ht__change_value(ht* h, bucket_t* bucket, ht_hash_t hash, void* item)
+static inline ht_size_t
+ht__shard_index(ht_hash_t hash, unsigned int shard_shift, ht_size_t shard_count)
+{
+    return (ht_size_t)(hash >> shard_shift) & (shard_count - 1);
+}
+
+static inline ht_bool
+ht__bucket_is_empty_at(const ht* h, ht_size_t index)
 {
-    bucket->hash = hash;
-    memcpy((char*)bucket + sizeof(bucket_t), item, h->sizeof_item);
+    return h->ctrl[index] == 0;
 }
 
+/* Distance of the item from its ideal bucket. Distance of an empty bucket is 0. */
 static inline ht_size_t
-ht__bucket_index(const ht* h, ht_hash_t hash)
+ht__distance_at(const ht* h, ht_size_t index)
 {
-    /* Equivalent to hash% h->bucket_capacity but faster since we are using power of two as bucket capacity. */
-    return hash & (h->bucket_capacity - 1);
+    unsigned char distance = h->distances[index];
+    /* Long distances don't fit in a byte, use the slow path. */
+    if (distance == DISTANCE_OVERFLOW)
+        return ht__bucket_distance(h, index, *ht__hash_at(h, index));
+
+    return distance;
 }
 
-static void
-ht__bucket_copy(ht* h, bucket_t* dest, bucket_t* src)
+static inline void
+ht__set_distance_at(ht* h, ht_size_t index, ht_size_t distance)
 {
-    memcpy(dest, src, h->sizeof_bucket);
+    h->distances[index] = distance < DISTANCE_OVERFLOW ? (unsigned char)distance : DISTANCE_OVERFLOW;
+
+    if (distance > h->max_distance)
+        h->max_distance = distance;
 }
 
-static inline
-ht_size_t ht__bucket_distance(const ht* h, ht_size_t first, ht_size_t last)
+static inline void
+ht__bucket_set_empty_at(ht* h, ht_size_t index)
 {
-    /* get distance and "wrap it" to fit inside the bucket indices. */
-    return ht__bucket_index(h, first - last);
+    *ht__hash_at(h, index) = RESERVED_HASH_FOR_EMPTY;
+    h->ctrl[index] = 0;
+    h->distances[index] = 0;
 }
 
 static void
-ht__bucket_set_empty(bucket_t* bucket)
+ht__bucket_set_at(ht* h, ht_size_t index, ht_hash_t hash, ht_size_t distance, const void* item)
 {
-    bucket->hash = RESERVED_HASH_FOR_EMPTY;
+    *ht__hash_at(h, index) = hash;
+    h->ctrl[index] = ht__fingerprint(hash);
+    ht__set_distance_at(h, index, distance);
+    memcpy(ht__item_at(h, index), item, h->sizeof_item);
 }
 
+/* Move the item of the 'src' bucket in the previous bucket. */
 static void
-ht__bucket_swap(ht* h, bucket_t* a, bucket_t* b)
+ht__bucket_shift_back(ht* h, ht_size_t src)
 {
-    memcpy(h->tmp_for_swap, a, h->sizeof_bucket);
-    memcpy(a, b, h->sizeof_bucket);
-    memcpy(b, h->tmp_for_swap, h->sizeof_bucket);
+    ht_size_t dest = ht__bucket_index(h, src - 1);
+    *ht__hash_at(h, dest) = *ht__hash_at(h, src);
+    h->ctrl[dest] = h->ctrl[src];
+    ht__set_distance_at(h, dest, ht__distance_at(h, src) - 1);
+    memcpy(ht__item_at(h, dest), ht__item_at(h, src), h->sizeof_item);
 }
 
-static ht_size_t
-ht__get_next_non_empty_bucket_from(ht* h, ht_size_t index)
+/* Swap the bucket at index with the entry being inserted.
+   The item of the bucket is copied in whichever of tmp_entry and tmp_for_swap does not hold the entry,
+   which becomes the new entry, so each swap copies the item twice instead of three times. */
+static void
+ht__bucket_swap_with_entry(ht* h, ht_size_t index, ht_hash_t* entry_hash, ht_size_t* entry_distance, const void** entry_item)
 {
-    if (!ht__bucket_is_empty_at(h, index)) return index;
+    ht_size_t distance = ht__distance_at(h, index);
+    ht__set_distance_at(h, index, *entry_distance);
+    *entry_distance = distance;
+
+    ht_hash_t* hash = ht__hash_at(h, index);
+    ht_hash_t tmp_hash = *hash;
+    *hash = *entry_hash;
+    *entry_hash = tmp_hash;
+    h->ctrl[index] = ht__fingerprint(*hash);
+
+    void* displaced = *entry_item == h->tmp_entry ? h->tmp_for_swap : h->tmp_entry;
+    void* item = ht__item_at(h, index);
+    memcpy(displaced, item, h->sizeof_item);
+    memcpy(item, *entry_item, h->sizeof_item);
+    *entry_item = displaced;
+}
 
+/* Return the index itself if the bucket is non-empty, returns the capacity if there is no more non-empty bucket. */
+static ht_size_t
+ht__get_next_non_empty_index(const ht* h, ht_size_t index)
+{
     /* Until bucket is non empty, advance to the next bucket. */
-    while (!ht__bucket_is_empty_at(h, index))
+    while (index < h->bucket_capacity && ht__bucket_is_empty_at(h, index))
     {
         index += 1;
     }
@@ -339,44 +807,184 @@ ht__get_next_non_empty_bucket_from(ht* h, ht_size_t index)
     return index;
 }
 
-/* Return the bucket itself if it's non-empty. */
-HT_API bucket_t*
-ht__get_next_non_empty_bucket(const ht* h, bucket_t* bucket)
+static void ht__finish_migration(ht* h);
+static ht_bool ht__insert_no_grow(ht* h, const void* item, ht_hash_t hash, ht_bool replace, void** inserted_or_updated);
+
+static void*
+ht__alloc(const ht* h, ht_size_t size)
+{
+    void* ptr = h->allocator.allocate
+        ? h->allocator.allocate(h->allocator.context, size)
+        : HT_MALLOC(size);
+    HT_ASSERT(ptr);
+    return ptr;
+}
+
+static void
+ht__free(const ht* h, void* ptr, ht_size_t size)
+{
+    if (!h->allocator.allocate)
+        HT_FREE(ptr);
+    else if (h->allocator.deallocate)
+        h->allocator.deallocate(h->allocator.context, ptr, size);
+}
+
+static void*
+ht__realloc(const ht* h, void* ptr, ht_size_t old_size, ht_size_t new_size)
 {
-    if (!ht__bucket_is_empty(bucket)) return bucket;
+    if (!h->allocator.allocate)
+    {
+        void* new_ptr = HT_REALLOC(ptr, new_size);
+        HT_ASSERT(new_ptr);
+        return new_ptr;
+    }
 
-    /* until bucket is non empty, advance to the next bucket. */
-    while (ht__bucket_is_empty(bucket))
+    if (h->allocator.reallocate)
     {
-        bucket = (bucket_t*)((char*)bucket + h->sizeof_bucket);
+        void* new_ptr = h->allocator.reallocate(h->allocator.context, ptr, old_size, new_size);
+        HT_ASSERT(new_ptr);
+        return new_ptr;
     }
 
-    return bucket;
+    void* new_ptr = ht__alloc(h, new_size);
+    memcpy(new_ptr, ptr, old_size);
+    ht__free(h, ptr, old_size);
+    return new_ptr;
 }
 
+static ht_size_t
+ht__next_power_of_two(ht_size_t v)
+{
+    ht_size_t result = 1;
+    while (result < v)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+/* All the arrays are stored in a single allocation:
+   | buckets | separated hashes (if any) | tmp_entry | tmp_for_swap | control bytes | distances |
+   Bytes are last since they don't need any alignment. */
+static ht_size_t
+ht__memory_size(const ht* h, ht_size_t capacity)
+{
+    ht_size_t hashes_size = h->separate_metadata ? capacity * sizeof(ht_hash_t) : 0;
+    return capacity * h->sizeof_bucket + hashes_size + h->sizeof_bucket + h->sizeof_bucket + capacity + capacity;
+}
+
+static void
+ht__assign_memory(ht* h, char* mem, ht_size_t capacity)
+{
+    ht_size_t buckets_size = capacity * h->sizeof_bucket;
+    ht_size_t hashes_size = h->separate_metadata ? capacity * sizeof(ht_hash_t) : 0;
+
+    h->buckets = mem;
+    h->hashes = h->separate_metadata ? mem + buckets_size : mem;
+    h->tmp_entry = mem + buckets_size + hashes_size;
+    h->tmp_for_swap = mem + buckets_size + hashes_size + h->sizeof_bucket;
+    h->ctrl = (unsigned char*)mem + buckets_size + hashes_size + h->sizeof_bucket + h->sizeof_bucket;
+    h->distances = h->ctrl + capacity;
+    h->bucket_capacity = capacity;
+    h->allocated_memory = ht__memory_size(h, capacity);
+
+    /* Computed once here so that inserting only compares integers.
+       At least one bucket stays empty since probing stops on empty buckets. */
+    h->grow_threshold = (ht_size_t)((double)capacity * h->max_load);
+    if (h->grow_threshold >= capacity)
+        h->grow_threshold = capacity - 1;
+
+    h->shrink_threshold = capacity > h->min_capacity ? (ht_size_t)((double)capacity * h->min_load) : 0;
+}
+
+/* Grow the table without any call to the hash function and without a second table.
+   The memory is reallocated, arrays are moved to their new offsets, then each item is moved from its old bucket
+   to the first empty bucket from its new ideal bucket, in a single pass.
+   Since the pass starts after an empty bucket, items are processed in the order of their ideal buckets,
+   which keeps the Robin Hood order, and an item never goes further than its old bucket (relatively to its new ideal block of buckets),
+   so it never lands on a bucket that has not been processed yet. */
 static void
 ht__resize_up(ht* h, ht_size_t new_item_capacity)
 {
     HT_ASSERT(ht_size(h) < new_item_capacity);
 
-    ht old_ht;
-    ht_init(&old_ht, h->sizeof_item, h->hash, h->items_are_same, h->swap_items, new_item_capacity);
+    /* Indices are computed with a mask so the capacity must be a power of two. */
+    ht_size_t new_capacity = ht__next_power_of_two(new_item_capacity);
+    ht_size_t old_capacity = h->bucket_capacity;
 
-    ht_swap(h, &old_ht);
+    if (new_capacity <= old_capacity)
+        return;
 
-    h->filled_bucket_count = 0;
+    if (old_capacity == 0)
+    {
+        ht__assign_memory(h, (char*)ht__alloc(h, ht__memory_size(h, new_capacity)), new_capacity);
+
+        /* Empty buckets are only identified by their control byte, the buckets themselves are left uninitialized. */
+        memset(h->ctrl, 0, new_capacity);
+        memset(h->distances, 0, new_capacity);
+        h->filled_bucket_count = 0;
+        h->max_distance = 0;
+        return;
+    }
+
+    ht old = *h;
+    char* mem = (char*)ht__realloc(h, h->buckets, h->allocated_memory, ht__memory_size(h, new_capacity));
+    ht__assign_memory(&old, mem, old_capacity);
+    ht__assign_memory(h, mem, new_capacity);
+
+    /* Arrays move to higher offsets so the last ones are moved first. */
+    memmove(h->distances, old.distances, old_capacity);
+    memmove(h->ctrl, old.ctrl, old_capacity);
+    if (h->separate_metadata)
+        memmove(h->hashes, old.hashes, old_capacity * sizeof(ht_hash_t));
+
+    /* New buckets are empty. */
+    ht_size_t i;
+    for (i = old_capacity; i < new_capacity; ++i)
+    {
+        ht__bucket_set_empty_at(h, i);
+    }
+
+    /* Find an empty bucket, there is always one since the table is never full. */
+    ht_size_t first_empty = 0;
+    while (!ht__bucket_is_empty_at(h, first_empty))
+    {
+        first_empty += 1;
+        HT_ASSERT(first_empty < old_capacity);
+    }
+
+    h->max_distance = 0;
 
-    bucket_t* bucket;
-    for (ht_each_bucket(&old_ht, bucket))
+    for (ht_size_t n = 1; n < old_capacity; ++n)
     {
-        if (!ht__bucket_is_empty(bucket))
+        ht_size_t old_index = (first_empty + n) & (old_capacity - 1);
+
+        if (ht__bucket_is_empty_at(h, old_index))
+            continue;
+
+        /* Free the bucket so that the item can stay in it. */
+        h->ctrl[old_index] = 0;
+
+        ht_hash_t hash = *ht__hash_at(h, old_index);
+        ht_size_t new_index = ht__bucket_index(h, hash);
+        ht_size_t distance = 0;
+        while (!ht__bucket_is_empty_at(h, new_index))
         {
-            void* item = ht__get_bucket_item(bucket);
-            ht_insert(h, item);
+            new_index = ht__bucket_index(h, new_index + 1);
+            distance += 1;
         }
-    }
 
-    ht_destroy(&old_ht);
+        if (new_index != old_index)
+        {
+            ht__bucket_set_at(h, new_index, hash, distance, ht__item_at(h, old_index));
+            ht__bucket_set_empty_at(h, old_index);
+        }
+        else
+        {
+            h->ctrl[old_index] = ht__fingerprint(hash);
+            ht__set_distance_at(h, old_index, distance);
+        }
+    }
 }
 
 HT_API void
@@ -386,58 +994,85 @@ ht_init(ht* h,
     ht_predicate_t items_are_same,
     ht_swap_function_t swap_items,
     ht_size_t initial_capacity)
+{
+    ht_init_ex(h, sizeof_item, hash, items_are_same, swap_items, initial_capacity, 0);
+}
+
+HT_API void
+ht_options_init(ht_options* options)
+{
+    memset(options, 0, sizeof(ht_options));
+}
+
+HT_API void
+ht_init_ex(ht* h,
+    ht_size_t sizeof_item,
+    ht_hash_function_t hash,
+    ht_predicate_t items_are_same,
+    ht_swap_function_t swap_items,
+    ht_size_t initial_capacity,
+    const ht_options* options)
 {
     HT_ASSERT(h);
     HT_ASSERT(sizeof_item);
     HT_ASSERT(items_are_same);
 
+    ht_options default_options;
+    if (!options)
+    {
+        ht_options_init(&default_options);
+        options = &default_options;
+    }
+
     memset(h, 0, sizeof(ht));
 
     h->sizeof_item = sizeof_item;
-
-    ht_size_t bucket_entry_size = sizeof(bucket_t) + sizeof_item;
-    // @TODO document this, this is for alignment
+    h->separate_metadata = options->separate_metadata;
+    h->incremental_resize = options->incremental_resize;
+
+    HT_ASSERT(options->max_load >= 0.0f && options->max_load < 1.0f);
+    h->max_load = options->max_load > 0.0f ? options->max_load : DEFAULT_MAX_LOAD;
+    h->growth_factor = options->growth_factor ? ht__next_power_of_two(options->growth_factor) : DEFAULT_GROWTH_FACTOR;
+    HT_ASSERT(h->growth_factor >= 2);
+    h->min_capacity = options->min_capacity ? ht__next_power_of_two(options->min_capacity) : DEFAULT_MIN_CAPACITY;
+    h->allocator = options->allocator;
+
+    HT_ASSERT(options->min_load >= 0.0f && options->min_load < h->max_load / 2);
+    h->min_load = options->min_load;
+
+    ht_size_t header_size = h->separate_metadata ? 0 : sizeof(bucket_t);
+    ht_size_t bucket_entry_size = header_size + sizeof_item;
+    /* Round up the bucket size so that the next header (or item) is aligned as a pointer. */
     while (bucket_entry_size & (sizeof(intptr_t) - 1))
     {
         ++bucket_entry_size;
     }
 
     h->sizeof_bucket = bucket_entry_size;
+    h->item_offset = header_size;
+    h->hash_stride = h->separate_metadata ? sizeof(ht_hash_t) : bucket_entry_size;
 
-    if (initial_capacity < 0)
-        initial_capacity = 0;
+    h->hash = hash;
+    h->items_are_same = items_are_same;
+    h->swap_items = swap_items;
 
     if (initial_capacity)
     {
-        ht_size_t bucket_capacity = initial_capacity * bucket_entry_size;
-        /* mem size for all the buckets and the temporary objects */
-        h->allocated_memory = bucket_capacity + bucket_entry_size + bucket_entry_size;
-        char* mem = (char*)HT_MALLOC(h->allocated_memory);
-        h->buckets = mem;
-        h->tmp_entry = mem + bucket_capacity;
-        h->tmp_for_swap = mem + bucket_capacity + bucket_entry_size;
-
-        h->bucket_capacity = initial_capacity;
-    }
-
-    /* Mark all bucket as empty. */
-    /* @TODO create an iterator */
-    for (ht_size_t i = 0; i < initial_capacity; ++i)
-    {
-        bucket_t* bucket = ht__bucket_at(h, i);
-        ht__bucket_set_empty(bucket);
+        ht__resize_up(h, initial_capacity);
     }
-
-    h->hash = hash;
-    h->items_are_same = items_are_same;
-    h->swap_items = swap_items;
 }
 
 HT_API void
 ht_destroy(ht* h)
 {
+    if (h->migrating)
+    {
+        ht_destroy(h->migrating);
+        ht__free(h, h->migrating, sizeof(ht));
+    }
+
     if (h->buckets)
-        HT_FREE(h->buckets);
+        ht__free(h, h->buckets, h->allocated_memory);
 
     memset(h, 0, sizeof(ht));
 }
@@ -445,27 +1080,110 @@ ht_destroy(ht* h)
 HT_API void
 ht_reserve(ht* h, ht_size_t item_count)
 {
+    ht__finish_migration(h);
+
+    ht_size_t old_capacity = h->bucket_capacity;
     ht__resize_up(h, item_count);
+
+    if (old_capacity != 0 && h->bucket_capacity != old_capacity)
+        h->grow_count += 1;
+}
+
+/* Move all items to a smaller array of buckets, their hashes are not computed again. */
+static void
+ht__resize_down(ht* h, ht_size_t new_capacity)
+{
+    HT_ASSERT(new_capacity < h->bucket_capacity);
+    HT_ASSERT(h->migrating == 0);
+
+    ht old = *h;
+    h->shrink_count += 1;
+
+    h->buckets = 0;
+    h->bucket_capacity = 0;
+    h->filled_bucket_count = 0;
+    h->max_distance = 0;
+    h->allocated_memory = 0;
+
+    if (new_capacity)
+    {
+        ht__resize_up(h, new_capacity);
+
+        void* inserted;
+        ht_size_t index;
+        for (ht_each_bucket_index(&old, index))
+        {
+            if (!ht__bucket_is_empty_at(&old, index))
+                ht__insert_no_grow(h, ht__item_at(&old, index), *ht__hash_at(&old, index), 1, &inserted);
+        }
+    }
+    else
+    {
+        h->hashes = 0;
+        h->ctrl = 0;
+        h->distances = 0;
+        h->tmp_entry = 0;
+        h->tmp_for_swap = 0;
+        h->grow_threshold = 0;
+        h->shrink_threshold = 0;
+    }
+
+    ht__free(h, old.buckets, old.allocated_memory);
+}
+
+HT_API void
+ht_shrink_to_fit(ht* h)
+{
+    ht__finish_migration(h);
+
+    if (h->bucket_capacity == 0)
+        return;
+
+    ht_size_t new_capacity = 0;
+    if (h->filled_bucket_count)
+    {
+        new_capacity = h->min_capacity;
+        while ((ht_size_t)((double)new_capacity * h->max_load) < h->filled_bucket_count)
+            new_capacity *= 2;
+    }
+
+    if (new_capacity < h->bucket_capacity)
+        ht__resize_down(h, new_capacity);
 }
 
 HT_API void
 ht_clear(ht* h)
 {
-    if (RESERVED_HASH_FOR_EMPTY == 0)
+    if (h->migrating)
+    {
+        ht_destroy(h->migrating);
+        ht__free(h, h->migrating, sizeof(ht));
+        h->migrating = 0;
+    }
+
+    if (RESERVED_HASH_FOR_EMPTY == 0 && h->separate_metadata)
+    {
+        memset(h->hashes, 0, h->bucket_capacity * sizeof(ht_hash_t));
+    }
+    else if (RESERVED_HASH_FOR_EMPTY == 0)
     {
         memset(h->buckets, 0, h->bucket_capacity * h->sizeof_bucket);
     }
     else
     {
         /* Mark all buckets with the empty flag */
-        bucket_t* bucket;
-        for (ht_each_bucket(h, bucket))
+        ht_size_t i;
+        for (ht_each_bucket_index(h, i))
         {
-            ht__bucket_set_empty(bucket);
+            ht__bucket_set_empty_at(h, i);
         }
     }
 
+    memset(h->ctrl, 0, h->bucket_capacity);
+    memset(h->distances, 0, h->bucket_capacity);
+
     h->filled_bucket_count = 0;
+    h->max_distance = 0;
 }
 
 HT_API void
@@ -479,113 +1197,302 @@ ht_swap(ht* h, ht* other)
 HT_API ht_bool
 ht_is_empty(const ht* h)
 {
-    return h->filled_bucket_count == 0;
+    return ht_size(h) == 0;
 }
 
 HT_API ht_size_t
 ht_size(const ht* h)
 {
-    return h->filled_bucket_count;
+    return h->filled_bucket_count + (h->migrating ? h->migrating->filled_bucket_count : 0);
 }
 
 HT_API ht_size_t
 ht_count(const ht* h)
 {
-    bucket_t* bucket;
+    ht_size_t i;
     ht_size_t count = 0;
-    for (ht_each_bucket(h, bucket))
+    for (ht_each_bucket_index(h, i))
     {
-        if (!ht__bucket_is_empty(bucket))
+        if (!ht__bucket_is_empty_at(h, i))
             ++count;
     }
 
+    if (h->migrating)
+        count += ht_count(h->migrating);
+
     return count;
 }
 
 HT_API void*
 ht_begin(const ht* h)
 {
-    return ht__get_next_non_empty_bucket(h, ht__bucket_begin(h));
+    return ht__bucket_at(h, ht__get_next_non_empty_index(h, 0));
 }
 
 HT_API void*
 ht_end(const ht* h)
 {
-    return ht__bucket_end(h);
+    return ht__bucket_at(h, h->bucket_capacity);
 }
 
+/* Probe bucket by bucket, starting from 'current_bucket_index' which can be anywhere between the target and the searched item.
+   'item' is either an item or a key, compared with 'is_same'. */
 static ht_bool
-ht__try_find_index(const ht* h, const void* item, ht_hash_t hash, ht_size_t* index)
+ht__try_find_index_from(const ht* h, const void* item, ht_hash_t hash, ht_predicate_t is_same, ht_size_t target_bucket_index, ht_size_t current_bucket_index, ht_size_t* index)
 {
-    if (ht_is_empty(h))
-        return 0;
-
-    ht_size_t target_bucket_index = ht__bucket_index(h, hash);
-    ht_size_t current_bucket_index = target_bucket_index;
+    current_bucket_index = ht__bucket_index(h, current_bucket_index);
+    ht_size_t target_distance = ht__bucket_distance(h, current_bucket_index, target_bucket_index);
 
-    for (;;)
+    /* Items are never further than max_distance from their ideal bucket. */
+    while (target_distance <= h->max_distance)
     {
-        bucket_t* current_bucket = ht__bucket_at(h, current_bucket_index);
-
-        /* If there is no value, we end here. */
-        if (ht__bucket_is_empty(current_bucket)) return 0;
+        /* If the bucket is empty (distance of 0) or if its item is closer to its ideal bucket
+           than we are to our target, the item cannot be further. */
+        if (ht__distance_at(h, current_bucket_index) < target_distance
+            || ht__bucket_is_empty_at(h, current_bucket_index))
+            return 0;
 
-        if (current_bucket->hash == hash
-            && h->items_are_same(ht__get_bucket_item(current_bucket), (void*)item))
+        if (*ht__hash_at(h, current_bucket_index) == hash
+            && is_same(ht__item_at(h, current_bucket_index), (void*)item))
         {
             *index = current_bucket_index;
             return 1;
         }
 
-        /* Due to the implementation, using "current_bucket->hash" is equivalent to use 'ht__bucket_index(current_bucket->hash).'
-           It's just prevent one unnecessary operation. */
-        ht_size_t current_distance = ht__bucket_distance(h, current_bucket_index, current_bucket->hash);
-        ht_size_t target_distance = ht__bucket_distance(h, current_bucket_index, target_bucket_index);
-
-        if (current_distance < target_distance)
-            return 0;
-
         current_bucket_index = ht__bucket_index(h, current_bucket_index + 1);
+        target_distance += 1;
     }
+
+    return 0;
 }
 
-HT_API ht_bool
-ht_contains(const ht* h, void* item)
+#if HT_GROUP_WIDTH
+
+typedef uint32_t ht__group_mask;
+
+/* Returns a mask with one bit set for each control byte of the group equal to 'value'. */
+static inline ht__group_mask
+ht__group_match(const unsigned char* ctrl, unsigned char value)
 {
-    ht_hash_t hash = ht__do_hash(h, item);
-    return ht_contains_h(h, item, hash);
+#if HT_GROUP_WIDTH == 32
+    __m256i group = _mm256_loadu_si256((const __m256i*)ctrl);
+    return (ht__group_mask)_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8((char)value)));
+#else
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (ht__group_mask)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)value)));
+#endif
 }
 
-HT_API ht_bool
-ht_contains_h(const ht* h, void* item, ht_hash_t hash)
+/* Returns a mask with one bit set for each bucket whose distance is lower than the distance
+   the searched item would have in it: 'first_distance' for the first bucket of the group, 'first_distance + 1' for the next one, etc.
+   'first_distance' + HT_GROUP_WIDTH must be lower than DISTANCE_OVERFLOW. */
+static inline ht__group_mask
+ht__group_match_closer(const unsigned char* distances, ht_size_t first_distance)
 {
-    ht_size_t index;
-    return ht__try_find_index(h, item, hash , &index);
+#if HT_GROUP_WIDTH == 32
+    __m256i group = _mm256_loadu_si256((const __m256i*)distances);
+    __m256i expected = _mm256_add_epi8(_mm256_set1_epi8((char)first_distance),
+        _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+            16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31));
+    /* distance >= expected if max(distance, expected) == distance */
+    __m256i not_closer = _mm256_cmpeq_epi8(_mm256_max_epu8(group, expected), group);
+    return ~(ht__group_mask)_mm256_movemask_epi8(not_closer);
+#else
+    __m128i group = _mm_loadu_si128((const __m128i*)distances);
+    __m128i expected = _mm_add_epi8(_mm_set1_epi8((char)first_distance),
+        _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    /* distance >= expected if max(distance, expected) == distance */
+    __m128i not_closer = _mm_cmpeq_epi8(_mm_max_epu8(group, expected), group);
+    return ~(ht__group_mask)_mm_movemask_epi8(not_closer) & 0xFFFF;
+#endif
 }
 
-HT_API void*
-ht_get_item(const ht* h, void* item)
+static inline unsigned int
+ht__count_trailing_zeros(ht__group_mask mask)
 {
-    ht_hash_t hash = ht__do_hash(h, item);
-    return ht_get_item_h(h, item, hash);
+#if defined(_MSC_VER)
+    unsigned long result;
+    _BitScanForward(&result, mask);
+    return (unsigned int)result;
+#else
+    return (unsigned int)__builtin_ctz(mask);
+#endif
 }
 
-HT_API void*
-ht_get_item_h(const ht* h, void* item, ht_hash_t hash)
+#endif /* HT_GROUP_WIDTH */
+
+static ht_bool
+ht__try_find_index_with(const ht* h, const void* item, ht_hash_t hash, ht_predicate_t is_same, ht_size_t* index)
 {
-    ht_size_t index = 0;
+    if (h->filled_bucket_count == 0)
+        return 0;
 
-    if (!ht__try_find_index(h, item, hash , &index))
+    ht_size_t target_bucket_index = ht__bucket_index(h, hash);
+
+#if HT_GROUP_WIDTH
+    /* The searched item is necessarily between the target bucket and the next empty bucket,
+       or the next bucket whose item is closer to its ideal bucket than we are to our target.
+       So we compare fingerprints of a whole group at once and stop at the first of those buckets.
+       Groups never wrap around, the end of the array is handled by the scalar version,
+       so are the distances that are too long to be compared with bytes. */
+    ht_size_t group_index = target_bucket_index;
+    ht_size_t group_distance = 0;
+    unsigned char fingerprint = ht__fingerprint(hash);
+
+    while (group_index + HT_GROUP_WIDTH <= h->bucket_capacity
+        && group_distance + HT_GROUP_WIDTH < DISTANCE_OVERFLOW)
     {
-        return 0;
-    }
+        /* Items are never further than max_distance from their ideal bucket. */
+        if (group_distance > h->max_distance)
+            return 0;
 
-    /* Bucket exists, get its value. */
-    return ht__get_bucket_item(ht__bucket_at(h, index));
-}
+        const unsigned char* group = h->ctrl + group_index;
+        ht__group_mask candidates = ht__group_match(group, fingerprint);
+        ht__group_mask empties = ht__group_match(group, 0)
+            | ht__group_match_closer(h->distances + group_index, group_distance);
 
-HT_API ht_bool
-ht_get(const ht* h, void* item, void* result_item)
+        /* Discard candidates after the first empty bucket. */
+        if (empties)
+            candidates &= (empties & (~empties + 1)) - 1;
+
+        while (candidates)
+        {
+            ht_size_t candidate_index = group_index + ht__count_trailing_zeros(candidates);
+
+            if (*ht__hash_at(h, candidate_index) == hash
+                && is_same(ht__item_at(h, candidate_index), (void*)item))
+            {
+                *index = candidate_index;
+                return 1;
+            }
+
+            /* Remove lowest bit. */
+            candidates &= candidates - 1;
+        }
+
+        if (empties)
+            return 0;
+
+        group_index += HT_GROUP_WIDTH;
+        group_distance += HT_GROUP_WIDTH;
+    }
+
+    return ht__try_find_index_from(h, item, hash, is_same, target_bucket_index, group_index, index);
+#else
+    return ht__try_find_index_from(h, item, hash, is_same, target_bucket_index, target_bucket_index, index);
+#endif
+}
+
+static ht_bool
+ht__try_find_index(const ht* h, const void* item, ht_hash_t hash, ht_size_t* index)
+{
+    return ht__try_find_index_with(h, item, hash, h->items_are_same, index);
+}
+
+HT_API ht_bool
+ht_contains(const ht* h, void* item)
+{
+    ht_hash_t hash = ht__do_hash(h, item);
+    return ht_contains_h(h, item, hash);
+}
+
+/* Find item (or key) in the table or in the table being migrated. */
+static void*
+ht__find_item_with(const ht* h, const void* item, ht_hash_t hash, ht_predicate_t is_same)
+{
+    ht_size_t index;
+    if (ht__try_find_index_with(h, item, hash, is_same, &index))
+        return ht__item_at(h, index);
+
+    if (h->migrating && ht__try_find_index_with(h->migrating, item, hash, is_same, &index))
+        return ht__item_at(h->migrating, index);
+
+    return 0;
+}
+
+static void*
+ht__find_item(const ht* h, const void* item, ht_hash_t hash)
+{
+    return ht__find_item_with(h, item, hash, h->items_are_same);
+}
+
+HT_API ht_bool
+ht_contains_h(const ht* h, void* item, ht_hash_t hash)
+{
+    return ht__find_item(h, item, hash) != 0;
+}
+
+HT_API void*
+ht_get_item(const ht* h, void* item)
+{
+    ht_hash_t hash = ht__do_hash(h, item);
+    return ht_get_item_h(h, item, hash);
+}
+
+HT_API void*
+ht_get_item_h(const ht* h, void* item, ht_hash_t hash)
+{
+    return ht__find_item(h, item, hash);
+}
+
+/* Prefetch the first bucket where an item with this hash could be. */
+static void
+ht__prefetch(const ht* h, ht_hash_t hash)
+{
+    ht_size_t index = ht__bucket_index(h, hash);
+    HT_PREFETCH(h->ctrl + index);
+    HT_PREFETCH(h->distances + index);
+    HT_PREFETCH(ht__hash_at(h, index));
+    if (h->separate_metadata)
+        HT_PREFETCH(ht__item_at(h, index));
+}
+
+/* Look up keys by batches of HT_BATCH_SIZE, hashes are computed if not provided. */
+static void
+ht__get_items_batch(const ht* h, const void* keys, const ht_hash_t* hashes, ht_size_t count, ht_size_t stride, void** out_items)
+{
+    ht_hash_t batch_hashes[HT_BATCH_SIZE];
+    const char* batch_keys = (const char*)keys;
+
+    for (ht_size_t first = 0; first < count; first += HT_BATCH_SIZE)
+    {
+        ht_size_t batch_count = count - first < HT_BATCH_SIZE ? count - first : HT_BATCH_SIZE;
+        const ht_hash_t* current_hashes = hashes ? hashes + first : batch_hashes;
+
+        if (!hashes)
+        {
+            for (ht_size_t i = 0; i < batch_count; ++i)
+                batch_hashes[i] = ht__do_hash(h, batch_keys + i * stride);
+        }
+
+        if (h->bucket_capacity)
+        {
+            for (ht_size_t i = 0; i < batch_count; ++i)
+                ht__prefetch(h, current_hashes[i]);
+        }
+
+        for (ht_size_t i = 0; i < batch_count; ++i)
+            out_items[first + i] = ht__find_item(h, batch_keys + i * stride, current_hashes[i]);
+
+        batch_keys += batch_count * stride;
+    }
+}
+
+HT_API void
+ht_get_items_batch(const ht* h, const void* keys, ht_size_t count, ht_size_t stride, void** out_items)
+{
+    ht__get_items_batch(h, keys, 0, count, stride, out_items);
+}
+
+HT_API void
+ht_get_items_batch_h(const ht* h, const void* keys, const ht_hash_t* hashes, ht_size_t count, ht_size_t stride, void** out_items)
+{
+    HT_ASSERT(hashes);
+    ht__get_items_batch(h, keys, hashes, count, stride, out_items);
+}
+
+HT_API ht_bool
+ht_get(const ht* h, void* item, void* result_item)
 {
     ht_hash_t hash = ht__do_hash(h, item);
     return ht_get_h(h, item, hash, result_item);
@@ -605,70 +1512,197 @@ ht_get_h(const ht* h, void* item, ht_hash_t hash, void* result_item)
     return 1;
 }
 
+/* Insert without checking the load of the table.
+   An existing item is replaced only if 'replace' is true, 'inserted_or_updated' points to it in any case. */
 static ht_bool
-ht__insert(ht* h, void* item, ht_hash_t hash, bucket_t** inserted_or_updated)
+ht__insert_no_grow(ht* h, const void* item, ht_hash_t hash, ht_bool replace, void** inserted_or_updated)
 {
-    if (h->bucket_capacity == 0
-        || h->filled_bucket_count + 1 > (h->bucket_capacity * MAX_LOAD))
-    {
-        /* set initial capacity or double it (to fit power of two pattern) */
-        ht_size_t next_capacity = h->bucket_capacity == 0 ? MIN_CAPACITY : h->bucket_capacity * 2;
-        ht__resize_up(h, next_capacity);
-    }
+    /* The entry being inserted is the hash + the item + its distance from its ideal bucket.
+       The item is copied straight from the caller to its bucket, it's only copied in a temporary buffer
+       when it displaces another item, which then becomes the entry. */
+    ht_hash_t entry_hash = hash;
+    ht_size_t entry_distance = 0;
+    const void* entry_item = item;
 
-    bucket_t* entry = (bucket_t*)h->tmp_entry;
-    ht__change_value(h, entry, hash, item);
-
-    size_t entry_ideal_bucket_index = ht__bucket_index(h, entry->hash);
-    size_t current_bucket_index = entry_ideal_bucket_index;
-    bucket_t* inserted_bucket = 0;
+    ht_size_t current_bucket_index = ht__bucket_index(h, entry_hash);
+    ht_bool inserted_bucket_found = 0;
 
     for (;;)
     {
-        bucket_t* current_bucket = ht__bucket_at(h, current_bucket_index);
-
-        if (ht__bucket_is_empty(current_bucket))
+        if (ht__bucket_is_empty_at(h, current_bucket_index))
         {
-            ht__bucket_copy(h, current_bucket, entry);
+            ht__bucket_set_at(h, current_bucket_index, entry_hash, entry_distance, entry_item);
             ++h->filled_bucket_count;
 
-            if (inserted_bucket == 0)
-                inserted_bucket = current_bucket;
+            if (!inserted_bucket_found)
+                *inserted_or_updated = ht__item_at(h, current_bucket_index);
 
-            *inserted_or_updated = inserted_bucket;
             return 1;
         }
         else {
 
-            /* value already exist return iterator */
-            if (current_bucket->hash == entry->hash
-                && h->items_are_same(ht__get_bucket_item(current_bucket), ht__get_bucket_item(entry)))
+            /* value already exist return iterator
+               (displaced items cannot have a duplicate, so this is only checked before the first displacement) */
+            if (!inserted_bucket_found
+                && *ht__hash_at(h, current_bucket_index) == entry_hash
+                && h->items_are_same(ht__item_at(h, current_bucket_index), (void*)entry_item))
             {
-                ht__bucket_copy(h, current_bucket, entry);
-                *inserted_or_updated = current_bucket;
+                /* The item might come from the bucket itself. */
+                if (replace && entry_item != ht__item_at(h, current_bucket_index))
+                    ht__bucket_set_at(h, current_bucket_index, entry_hash, entry_distance, entry_item);
+                *inserted_or_updated = ht__item_at(h, current_bucket_index);
                 return 0;
             }
 
-            /* Due to the implementation, using "current_bucket->hash" is equivalent to use 'ht__bucket_index(current_bucket->hash)'
-               It's just prevent one unnecessary operation.
-               index - hash will result in a value (index) that will get "wrapped" within the size of the array. */
-            size_t current_distance = ht__bucket_distance(h, current_bucket_index, current_bucket->hash);
-            size_t ideal_distance = ht__bucket_distance(h, current_bucket_index, entry_ideal_bucket_index);
-            if (current_distance < ideal_distance)
+            if (ht__distance_at(h, current_bucket_index) < entry_distance)
             {
-                ht__bucket_swap(h, current_bucket, entry);
-
-                if (inserted_bucket == 0)
-                    inserted_bucket = current_bucket;
-
-                /* At this point we have to update the ideal bucket index, we used the hash earlier to calculate 'current_distance' as an optimization.
-                   Note that "entry" is used because it got swapped with current_bucket earlier. */
-                entry_ideal_bucket_index = ht__bucket_index(h, entry->hash);
+                /* Entry is now the item that was in the current bucket, with its own distance. */
+                ht__bucket_swap_with_entry(h, current_bucket_index, &entry_hash, &entry_distance, &entry_item);
+
+                if (!inserted_bucket_found)
+                {
+                    *inserted_or_updated = ht__item_at(h, current_bucket_index);
+                    inserted_bucket_found = 1;
+                }
             }
             /* get next bucket */
             current_bucket_index = ht__bucket_index(h, current_bucket_index + 1);
+            entry_distance += 1;
+        }
+    }
+}
+
+/* Remove the item at index, following items of the cluster are shifted back. */
+static void
+ht__erase_at(ht* h, ht_size_t index)
+{
+    ht_size_t current_bucket_index = index;
+
+    for (;;) {
+        ht_size_t next_bucket_index = ht__bucket_index(h, current_bucket_index + 1);
+
+        /* Stop if next bucket is empty or if its item is already in its ideal bucket. */
+        if (h->distances[next_bucket_index] == 0)
+        {
+            break;
+        }
+
+        ht__bucket_shift_back(h, next_bucket_index);
+
+        current_bucket_index = next_bucket_index;
+    }
+
+    ht__bucket_set_empty_at(h, current_bucket_index);
+
+    --h->filled_bucket_count;
+}
+
+/* Move at most 'bucket_count' buckets of the migrating table, the migrating table is destroyed once it's empty. */
+static void
+ht__migrate(ht* h, ht_size_t bucket_count)
+{
+    ht* old = h->migrating;
+
+    while (bucket_count > 0 && h->migration_index < old->bucket_capacity)
+    {
+        ht_size_t index = h->migration_index;
+        bucket_count -= 1;
+
+        if (ht__bucket_is_empty_at(old, index))
+        {
+            h->migration_index += 1;
+            continue;
+        }
+
+        void* inserted;
+        ht__insert_no_grow(h, ht__item_at(old, index), *ht__hash_at(old, index), 1, &inserted);
+
+        /* Next items are shifted back so the same bucket is processed again.
+           Buckets before it stay empty since the first bucket is processed first. */
+        ht__erase_at(old, index);
+    }
+
+    if (h->migration_index >= old->bucket_capacity)
+    {
+        HT_ASSERT(old->filled_bucket_count == 0);
+        ht_destroy(old);
+        ht__free(h, old, sizeof(ht));
+        h->migrating = 0;
+    }
+}
+
+static void
+ht__finish_migration(ht* h)
+{
+    if (h->migrating)
+        ht__migrate(h, (ht_size_t)-1);
+}
+
+/* The current buckets become the migrating table and new buckets are allocated. */
+static void
+ht__start_migration(ht* h, ht_size_t new_capacity)
+{
+    ht__finish_migration(h);
+
+    ht* old = (ht*)ht__alloc(h, sizeof(ht));
+    *old = *h;
+
+    h->buckets = 0;
+    h->bucket_capacity = 0;
+    h->filled_bucket_count = 0;
+    h->max_distance = 0;
+    ht__resize_up(h, new_capacity);
+
+    h->migrating = old;
+    h->migration_index = 0;
+}
+
+/* Next capacity able to hold 'item_count' items without exceeding the max load. */
+static ht_size_t
+ht__grown_capacity(const ht* h, ht_size_t item_count)
+{
+    /* set initial capacity or multiply it (to fit power of two pattern) */
+    ht_size_t next_capacity = h->bucket_capacity == 0 ? h->min_capacity : h->bucket_capacity * h->growth_factor;
+    while ((ht_size_t)((double)next_capacity * h->max_load) < item_count)
+    {
+        next_capacity *= h->growth_factor;
+    }
+    return next_capacity;
+}
+
+static ht_bool
+ht__insert(ht* h, const void* item, ht_hash_t hash, ht_bool replace, void** inserted_or_updated)
+{
+    /* grow_threshold is 0 while nothing is allocated. */
+    if (ht_size(h) + 1 > h->grow_threshold)
+    {
+        ht_size_t next_capacity = ht__grown_capacity(h, ht_size(h) + 1);
+
+        if (h->bucket_capacity != 0)
+            h->grow_count += 1;
+
+        if (h->incremental_resize && h->bucket_capacity != 0)
+            ht__start_migration(h, next_capacity);
+        else
+            ht__resize_up(h, next_capacity);
+    }
+
+    if (h->migrating)
+    {
+        ht__migrate(h, HT_INCREMENTAL_STEP);
+
+        /* The item may not have been moved yet. */
+        ht_size_t index;
+        if (h->migrating && ht__try_find_index(h->migrating, item, hash, &index))
+        {
+            if (replace)
+                ht__bucket_set_at(h->migrating, index, hash, ht__distance_at(h->migrating, index), item);
+            *inserted_or_updated = ht__item_at(h->migrating, index);
+            return 0;
         }
     }
+
+    return ht__insert_no_grow(h, item, hash, replace, inserted_or_updated);
 }
 
 HT_API ht_bool
@@ -681,39 +1715,159 @@ ht_insert(ht* h, void* item)
 HT_API ht_bool
 ht_insert_h(ht* h, void* item, ht_hash_t hash)
 {
-    bucket_t* inserted_or_updated = 0;
-    return ht__insert(h, item, hash , &inserted_or_updated);
+    void* inserted_or_updated = 0;
+    return ht__insert(h, item, hash, 1, &inserted_or_updated);
+}
+
+HT_API void*
+ht_find_or_insert(ht* h, void* item, ht_bool* was_inserted)
+{
+    ht_hash_t hash = ht__do_hash(h, item);
+    return ht_find_or_insert_h(h, item, hash, was_inserted);
+}
+
+HT_API void*
+ht_find_or_insert_h(ht* h, void* item, ht_hash_t hash, ht_bool* was_inserted)
+{
+    void* found_or_inserted = 0;
+    ht_bool inserted = ht__insert(h, item, hash, 0, &found_or_inserted);
+
+    if (was_inserted)
+        *was_inserted = inserted;
+
+    return found_or_inserted;
+}
+
+/* Make room for 'count' more items at once. */
+static void
+ht__reserve_many(ht* h, ht_size_t count)
+{
+    ht__finish_migration(h);
+
+    if (h->filled_bucket_count + count > h->grow_threshold)
+    {
+        if (h->bucket_capacity != 0)
+            h->grow_count += 1;
+
+        ht__resize_up(h, ht__grown_capacity(h, h->filled_bucket_count + count));
+    }
 }
 
 HT_API ht_size_t
-ht_erase_at(ht* h, ht_size_t index)
+ht_insert_many(ht* h, const void* items, ht_size_t count)
 {
-    HT_ASSERT(index >= 0);
+    if (count == 0)
+        return 0;
 
-    ht_size_t current_bucket_index = index;
-    bucket_t* current_bucket = ht__bucket_at(h, current_bucket_index);
+    ht__reserve_many(h, count);
 
-    for (;;) {
-        size_t next_bucket_index = ht__bucket_index(h, current_bucket_index + 1);
-        bucket_t* next_bucket = ht__bucket_at(h, next_bucket_index);
+    ht_hash_t hashes[HT_BATCH_SIZE];
+    const char* batch_items = (const char*)items;
+    ht_size_t inserted_count = 0;
+    void* inserted;
 
-        if (ht__bucket_is_empty(next_bucket)
-            || ht__bucket_distance(h, next_bucket_index, next_bucket->hash) <= 0)
+    /* Hashes of a batch are computed first so that the buckets can be prefetched. */
+    for (ht_size_t first = 0; first < count; first += HT_BATCH_SIZE)
+    {
+        ht_size_t batch_count = count - first < HT_BATCH_SIZE ? count - first : HT_BATCH_SIZE;
+
+        for (ht_size_t i = 0; i < batch_count; ++i)
         {
-            break;
+            hashes[i] = ht__do_hash(h, batch_items + i * h->sizeof_item);
+            ht__prefetch(h, hashes[i]);
         }
 
-        ht__bucket_copy(h, current_bucket, next_bucket);
+        for (ht_size_t i = 0; i < batch_count; ++i)
+        {
+            inserted_count += ht__insert_no_grow(h, batch_items + i * h->sizeof_item, hashes[i], 1, &inserted);
+        }
 
-        current_bucket_index = next_bucket_index;
-        current_bucket = next_bucket;
+        batch_items += batch_count * h->sizeof_item;
     }
 
-    ht__bucket_set_empty(current_bucket);
+    return inserted_count;
+}
 
-    --h->filled_bucket_count;
+typedef struct ht__hashed_index ht__hashed_index;
+struct ht__hashed_index {
+    ht_hash_t hash;
+    ht_size_t index;
+};
+
+/* Stable radix sort by ideal bucket, 8 bits at a time. 'tmp' must be as big as 'entries'. */
+static void
+ht__sort_by_bucket(const ht* h, ht__hashed_index* entries, ht__hashed_index* tmp, ht_size_t count)
+{
+    ht_size_t mask = h->bucket_capacity - 1;
+    ht__hashed_index* src = entries;
+    ht__hashed_index* dst = tmp;
+
+    for (unsigned int shift = 0; (mask >> shift) != 0; shift += 8)
+    {
+        ht_size_t offsets[256];
+        memset(offsets, 0, sizeof(offsets));
+
+        for (ht_size_t i = 0; i < count; ++i)
+            offsets[((src[i].hash & mask) >> shift) & 0xFF] += 1;
+
+        ht_size_t offset = 0;
+        for (int digit = 0; digit < 256; ++digit)
+        {
+            ht_size_t digit_count = offsets[digit];
+            offsets[digit] = offset;
+            offset += digit_count;
+        }
+
+        for (ht_size_t i = 0; i < count; ++i)
+            dst[offsets[((src[i].hash & mask) >> shift) & 0xFF]++] = src[i];
+
+        ht__hashed_index* swap = src;
+        src = dst;
+        dst = swap;
+    }
 
-    return ht__get_next_non_empty_bucket_from(h, index);
+    if (src != entries)
+        memcpy(entries, src, count * sizeof(ht__hashed_index));
+}
+
+HT_API ht_size_t
+ht_insert_many_sorted(ht* h, const void* items, ht_size_t count)
+{
+    if (count == 0)
+        return 0;
+
+    ht__reserve_many(h, count);
+
+    ht__hashed_index* entries = (ht__hashed_index*)ht__alloc(h, 2 * count * sizeof(ht__hashed_index));
+
+    const char* bytes = (const char*)items;
+    for (ht_size_t i = 0; i < count; ++i)
+    {
+        entries[i].hash = ht__do_hash(h, bytes + i * h->sizeof_item);
+        entries[i].index = i;
+    }
+
+    ht__sort_by_bucket(h, entries, entries + count, count);
+
+    ht_size_t inserted_count = 0;
+    void* inserted;
+    for (ht_size_t i = 0; i < count; ++i)
+    {
+        inserted_count += ht__insert_no_grow(h, bytes + entries[i].index * h->sizeof_item, entries[i].hash, 1, &inserted);
+    }
+
+    ht__free(h, entries, 2 * count * sizeof(ht__hashed_index));
+
+    return inserted_count;
+}
+
+HT_API void
+ht_erase_at(ht* h, ht_size_t index)
+{
+    HT_ASSERT(index < h->bucket_capacity);
+    HT_ASSERT(!ht__bucket_is_empty_at(h, index));
+
+    ht__erase_at(h, index);
 }
 
 HT_API ht_bool
@@ -723,25 +1877,98 @@ ht_erase(ht* h, void* item)
     return ht_erase_h(h, item, hash);
 }
 
-HT_API ht_bool
-ht_erase_h(ht* h, void* item, ht_hash_t hash)
+static ht_bool
+ht__erase_with(ht* h, const void* item, ht_hash_t hash, ht_predicate_t is_same)
 {
+    if (h->migrating)
+        ht__migrate(h, HT_INCREMENTAL_STEP);
+
     ht_size_t index;
-    if (ht__try_find_index(h, item, hash , &index))
+    if (ht__try_find_index_with(h, item, hash, is_same, &index))
     {
-        ht_erase_at(h, index);
+        ht__erase_at(h, index);
+
+        if (h->filled_bucket_count < h->shrink_threshold && !h->migrating)
+            ht__resize_down(h, h->bucket_capacity / 2);
+
+        return 1;
+    }
+
+    if (h->migrating && ht__try_find_index_with(h->migrating, item, hash, is_same, &index))
+    {
+        ht__erase_at(h->migrating, index);
         return 1;
     }
     return 0;
 }
 
+HT_API ht_bool
+ht_erase_h(ht* h, void* item, ht_hash_t hash)
+{
+    return ht__erase_with(h, item, hash, h->items_are_same);
+}
+
+/* ht_key_predicate_t has the same signature as ht_predicate_t, the key takes the place of the searched item. */
+
+HT_API void*
+ht_get_item_by_key(const ht* h, void* key, ht_key_hash_function_t key_hash, ht_key_predicate_t item_has_key)
+{
+    return ht__find_item_with(h, key, ht__adjust_hash(key_hash(key)), item_has_key);
+}
+
+HT_API ht_bool
+ht_contains_key(const ht* h, void* key, ht_key_hash_function_t key_hash, ht_key_predicate_t item_has_key)
+{
+    return ht__find_item_with(h, key, ht__adjust_hash(key_hash(key)), item_has_key) != 0;
+}
+
+HT_API ht_bool
+ht_erase_key(ht* h, void* key, ht_key_hash_function_t key_hash, ht_key_predicate_t item_has_key)
+{
+    return ht__erase_with(h, key, ht__adjust_hash(key_hash(key)), item_has_key);
+}
+
+HT_API void*
+ht_get_item_by_key_h(const ht* h, void* key, ht_hash_t hash, ht_key_predicate_t item_has_key)
+{
+    return ht__find_item_with(h, key, hash, item_has_key);
+}
+
+HT_API ht_bool
+ht_contains_key_h(const ht* h, void* key, ht_hash_t hash, ht_key_predicate_t item_has_key)
+{
+    return ht__find_item_with(h, key, hash, item_has_key) != 0;
+}
+
+HT_API ht_bool
+ht_erase_key_h(ht* h, void* key, ht_hash_t hash, ht_key_predicate_t item_has_key)
+{
+    return ht__erase_with(h, key, hash, item_has_key);
+}
+
 HT_API void
 ht_cursor_init(ht* h, ht_cursor* cursor)
 {
     ht_cursor c;
 
+    /* Iterate over a single array of buckets. */
+    ht__finish_migration(h);
+
     c.current_bucket = h->buckets - h->sizeof_bucket;
+    c.index = (ht_size_t)-1;
     c.h = h;
+    c.start = 0;
+    c.position = 0;
+
+    /* Buckets are visited in circle from the bucket following an empty one, so no cluster of items
+       is split by the start of the iteration. Erasing an item only shifts back items which are not visited yet.
+       There is always an empty bucket since the table never gets full. */
+    if (h->filled_bucket_count)
+    {
+        while (!ht__bucket_is_empty_at(h, c.start))
+            c.start += 1;
+        c.start = ht__bucket_index(h, c.start + 1);
+    }
 
     *cursor = c;
 }
@@ -755,35 +1982,111 @@ ht_cursor_end(const ht_cursor* cursor)
 HT_API void*
 ht_cursor_next(ht_cursor* cursor)
 {
-    if (cursor->current_bucket >= ht_end(cursor->h))
-    {
-        return 0;
-    }
-
-    /* current bucket */
-    bucket_t* bucket = (bucket_t*)cursor->current_bucket;
-    /* go to next bucket, which can be empty */
-    bucket = (bucket_t*)((char*)bucket + cursor->h->sizeof_bucket);
-    /* if empty bucket go to next non-empty */
-    bucket = ht__get_next_non_empty_bucket(cursor->h, bucket);
+    const ht* h = cursor->h;
 
-    cursor->current_bucket = bucket;
+    /* go to next bucket, which can be empty, if empty go to next non-empty */
+    while (cursor->position < h->bucket_capacity)
+    {
+        ht_size_t index = ht__bucket_index(h, cursor->start + cursor->position);
+        cursor->position += 1;
 
-    ht_bool is_valid_bucket = (void*)bucket < ht_end(cursor->h);
+        if (!ht__bucket_is_empty_at(h, index))
+        {
+            cursor->index = index;
+            cursor->current_bucket = ht__bucket_at(h, index);
+            return cursor->current_bucket;
+        }
+    }
 
-    return is_valid_bucket ? bucket : 0;
+    cursor->index = h->bucket_capacity;
+    cursor->current_bucket = ht_end(h);
+    return 0;
 }
 
 HT_API void*
 ht_cursor_item(const ht_cursor* cursor)
 {
-    return ht__get_bucket_item((bucket_t*)cursor->current_bucket);
+    return ht__item_at(cursor->h, cursor->index);
+}
+
+HT_API void
+ht_cursor_erase(ht_cursor* cursor)
+{
+    ht_erase_at(cursor->h, cursor->index);
+
+    /* The next item may have been shifted back to the current bucket. */
+    cursor->position -= 1;
 }
 
 HT_API ht_size_t
 ht_allocated_memory(const ht* h)
 {
-    return h->allocated_memory;
+    return h->allocated_memory + (h->migrating ? sizeof(ht) + h->migrating->allocated_memory : 0);
+}
+
+/* Add the distances and clusters of the buckets of a table (and not of its migrating table) to 'out'. */
+static void
+ht__add_stats(const ht* h, ht_statistics* out, double* distance_sum)
+{
+    if (h->bucket_capacity == 0)
+        return;
+
+    /* Start after an empty bucket so that no cluster is cut by the end of the array. */
+    ht_size_t first_empty = 0;
+    while (!ht__bucket_is_empty_at(h, first_empty))
+        first_empty += 1;
+
+    ht_size_t cluster_size = 0;
+    for (ht_size_t n = 1; n <= h->bucket_capacity; ++n)
+    {
+        ht_size_t index = ht__bucket_index(h, first_empty + n);
+
+        if (ht__bucket_is_empty_at(h, index))
+        {
+            if (cluster_size)
+            {
+                out->cluster_count += 1;
+                if (cluster_size > out->max_cluster_size)
+                    out->max_cluster_size = cluster_size;
+            }
+            cluster_size = 0;
+            continue;
+        }
+
+        cluster_size += 1;
+
+        ht_size_t distance = ht__distance_at(h, index);
+        *distance_sum += (double)distance;
+        if (distance > out->max_distance)
+            out->max_distance = distance;
+        out->distance_histogram[distance < HT_STATS_HISTOGRAM_SIZE ? distance : HT_STATS_HISTOGRAM_SIZE - 1] += 1;
+    }
+}
+
+HT_API void
+ht_stats(const ht* h, ht_statistics* out)
+{
+    memset(out, 0, sizeof(ht_statistics));
+
+    double distance_sum = 0.0;
+    ht__add_stats(h, out, &distance_sum);
+    if (h->migrating)
+        ht__add_stats(h->migrating, out, &distance_sum);
+
+    out->item_count = ht_size(h);
+    out->bucket_capacity = h->bucket_capacity;
+    out->load_factor = h->bucket_capacity ? (float)((double)h->filled_bucket_count / (double)h->bucket_capacity) : 0.0f;
+
+    out->allocated_memory = ht_allocated_memory(h);
+    out->grow_count = h->grow_count;
+    out->shrink_count = h->shrink_count;
+
+    if (out->item_count)
+    {
+        out->mean_distance = (float)(distance_sum / (double)out->item_count);
+        out->mean_cluster_size = (float)((double)out->item_count / (double)out->cluster_count);
+        out->bytes_per_item = (float)((double)out->allocated_memory / (double)out->item_count);
+    }
 }
 
 HT_API void
@@ -0,0 +1,476 @@
+/*
+
+SUMMARY:
+
+    Hash table for concurrent reads and writes, read-mostly workloads.
+    It's using ht.h
+    
+    Items are spread in shards according to the high bits of their hash, each shard is a ht.
+    Writers lock the shard of the item, so writers of different shards do not wait for each other.
+    Readers never lock, they use the sequence number of the shard (seqlock):
+    the sequence is odd while a writer modifies the shard, a reader copies the item found
+    and tries again if the sequence changed in between.
+
+NOTES:
+
+    ht.h must be used.
+
+    Readers might see an item while it's being modified, the result is then discarded.
+    Hash and comparison functions must therefore accept any bytes,
+    keys must be plain data (integers, inline arrays of char, etc.), not pointers.
+
+    Memory released by writers when a shard grows or shrinks can still be read by a reader,
+    it's kept until ht_concurrent_collect or ht_concurrent_destroy is called, while no reader is running.
+
+    Threads are pthreads, or Windows threads on Windows.
+
+    Size of the cache lines, used to keep shards apart:
+        #define HT_CONCURRENT_CACHE_LINE 64
+
+    Number of times a reader checks the sequence of a shard being written before waiting on the mutex of the writer:
+        #define HT_CONCURRENT_SPIN_COUNT 64
+
+EXAMPLE:
+
+    ht_concurrent c;
+    ht_concurrent_init(&c, sizeof(struct item_t), hash, items_are_same, 16, 0);
+
+    // Writers
+    ht_concurrent_insert(&c, &item);
+
+    // Readers
+    struct item_t result;
+    if (ht_concurrent_get(&c, &item, &result))
+    {
+        ...
+    }
+
+    ht_concurrent_destroy(&c);
+*/
+
+#ifndef RE_HT_CONCURRENT_H
+#define RE_HT_CONCURRENT_H
+
+#include "ht.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+typedef SRWLOCK ht_concurrent_mutex;
+#else
+#include <pthread.h>
+typedef pthread_mutex_t ht_concurrent_mutex;
+#endif
+
+#ifndef HT_CONCURRENT_CACHE_LINE
+#define HT_CONCURRENT_CACHE_LINE 64
+#endif
+
+#ifndef HT_CONCURRENT_SPIN_COUNT
+#define HT_CONCURRENT_SPIN_COUNT 64
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ht_concurrent_shard ht_concurrent_shard;
+struct ht_concurrent_shard {
+    volatile unsigned int sequence; /* odd while the table is being modified */
+    ht_concurrent_mutex mutex;      /* held by writers */
+    ht table;
+
+    void** retired;                 /* memory released by the table, readers might still use it */
+    ht_size_t retired_count;
+    ht_size_t retired_capacity;
+
+    char padding[HT_CONCURRENT_CACHE_LINE]; /* so that the sequence does not share its cache line with the previous shard */
+};
+
+typedef struct ht_concurrent ht_concurrent;
+struct ht_concurrent {
+    ht_concurrent_shard* shards;
+    ht_size_t shard_count;    /* power of two */
+    unsigned int shard_shift; /* shard of a hash is (hash >> shard_shift) & (shard_count - 1) */
+};
+
+/* shard_count is rounded up to a power of two, options can be null.
+   options.incremental_resize and options.allocator are not supported. */
+HT_API void ht_concurrent_init(ht_concurrent* c,
+    ht_size_t sizeof_item,
+    ht_hash_function_t hash,
+    ht_predicate_t items_are_same,
+    ht_size_t shard_count,
+    const ht_options* options);
+
+/* No other thread must use the table. */
+HT_API void ht_concurrent_destroy(ht_concurrent* c);
+
+/* Returns true if item was inserted, false if item was replaced. */
+HT_API ht_bool ht_concurrent_insert(ht_concurrent* c, void* item);
+
+/* Delete item, returns true if it was deleted. */
+HT_API ht_bool ht_concurrent_erase(ht_concurrent* c, void* item);
+
+/* Copy the item found into result, returns true if item was found. Never blocks writers. */
+HT_API ht_bool ht_concurrent_get(ht_concurrent* c, void* item, void* result);
+
+/* Returns true if item was found. Never blocks writers. */
+HT_API ht_bool ht_concurrent_contains(ht_concurrent* c, void* item);
+
+/* Number of items, it can be outdated as soon as it's returned if writers are running. */
+HT_API ht_size_t ht_concurrent_size(ht_concurrent* c);
+
+/* Release the memory kept for readers, no reader must be running. */
+HT_API void ht_concurrent_collect(ht_concurrent* c);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* RE_HT_CONCURRENT_H */
+
+#if defined(HT_IMPLEMENTATION) && !defined(RE_HT_CONCURRENT_IMPLEMENTATION)
+#define RE_HT_CONCURRENT_IMPLEMENTATION
+
+#include <string.h> /* memcpy, memset */
+
+#if defined(_WIN32)
+
+static void ht__concurrent_mutex_init(ht_concurrent_mutex* m) { InitializeSRWLock(m); }
+static void ht__concurrent_mutex_destroy(ht_concurrent_mutex* m) { (void)m; }
+static void ht__concurrent_lock(ht_concurrent_mutex* m) { AcquireSRWLockExclusive(m); }
+static void ht__concurrent_unlock(ht_concurrent_mutex* m) { ReleaseSRWLockExclusive(m); }
+
+static unsigned int
+ht__concurrent_load_acquire(const volatile unsigned int* sequence)
+{
+    unsigned int value = *sequence;
+    MemoryBarrier();
+    return value;
+}
+
+static void
+ht__concurrent_store_release(volatile unsigned int* sequence, unsigned int value)
+{
+    MemoryBarrier();
+    *sequence = value;
+}
+
+#define ht__concurrent_acquire_fence() MemoryBarrier()
+#define ht__concurrent_release_fence() MemoryBarrier()
+#define ht__concurrent_pause() YieldProcessor()
+
+#else
+
+static void ht__concurrent_mutex_init(ht_concurrent_mutex* m) { pthread_mutex_init(m, 0); }
+static void ht__concurrent_mutex_destroy(ht_concurrent_mutex* m) { pthread_mutex_destroy(m); }
+static void ht__concurrent_lock(ht_concurrent_mutex* m) { pthread_mutex_lock(m); }
+static void ht__concurrent_unlock(ht_concurrent_mutex* m) { pthread_mutex_unlock(m); }
+
+static unsigned int
+ht__concurrent_load_acquire(const volatile unsigned int* sequence)
+{
+    return __atomic_load_n(sequence, __ATOMIC_ACQUIRE);
+}
+
+static void
+ht__concurrent_store_release(volatile unsigned int* sequence, unsigned int value)
+{
+    __atomic_store_n(sequence, value, __ATOMIC_RELEASE);
+}
+
+/* Both are free on x86, they only prevent the compiler from reordering. */
+#define ht__concurrent_acquire_fence() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define ht__concurrent_release_fence() __atomic_thread_fence(__ATOMIC_RELEASE)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ht__concurrent_pause() __builtin_ia32_pause()
+#else
+#define ht__concurrent_pause() ((void)0)
+#endif
+
+#endif
+
+/* Allocator of the tables, released memory is kept until no reader can use it. */
+
+static void*
+ht__concurrent_alloc(void* context, ht_size_t size)
+{
+    (void)context;
+    return HT_MALLOC(size);
+}
+
+static void
+ht__concurrent_retire(void* context, void* ptr, ht_size_t size)
+{
+    ht_concurrent_shard* shard = (ht_concurrent_shard*)context;
+    (void)size;
+
+    if (shard->retired_count == shard->retired_capacity)
+    {
+        shard->retired_capacity = shard->retired_capacity ? shard->retired_capacity * 2 : 8;
+        shard->retired = (void**)HT_REALLOC(shard->retired, shard->retired_capacity * sizeof(void*));
+        HT_ASSERT(shard->retired);
+    }
+
+    shard->retired[shard->retired_count] = ptr;
+    shard->retired_count += 1;
+}
+
+static void
+ht__concurrent_release_retired(ht_concurrent_shard* shard)
+{
+    for (ht_size_t i = 0; i < shard->retired_count; ++i)
+        HT_FREE(shard->retired[i]);
+
+    shard->retired_count = 0;
+}
+
+static ht_concurrent_shard*
+ht__concurrent_shard_of(ht_concurrent* c, ht_hash_t hash)
+{
+    /* Shards use the high bits of the hash, their table use the low bits. */
+    return &c->shards[ht__shard_index(hash, c->shard_shift, c->shard_count)];
+}
+
+/* The sequence is odd from begin_write to end_write. */
+
+static void
+ht__concurrent_begin_write(ht_concurrent_shard* shard)
+{
+    ht__concurrent_lock(&shard->mutex);
+    ht__concurrent_store_release(&shard->sequence, shard->sequence + 1);
+    /* The sequence must be odd before the table is modified. */
+    ht__concurrent_release_fence();
+}
+
+static void
+ht__concurrent_end_write(ht_concurrent_shard* shard)
+{
+    ht__concurrent_store_release(&shard->sequence, shard->sequence + 1);
+    ht__concurrent_unlock(&shard->mutex);
+}
+
+/* Copy the item into result (if any) when it's found in a state of the table that no writer has modified. */
+static ht_bool
+ht__concurrent_read(ht_concurrent_shard* shard, const void* item, ht_hash_t hash, void* result)
+{
+    int spin_count = 0;
+
+    for (;;)
+    {
+        unsigned int sequence = ht__concurrent_load_acquire(&shard->sequence);
+        if (sequence & 1)
+        {
+            /* A writer is running, wait on its mutex if it takes too long (it might have been preempted). */
+            if (++spin_count < HT_CONCURRENT_SPIN_COUNT)
+            {
+                ht__concurrent_pause();
+            }
+            else
+            {
+                ht__concurrent_lock(&shard->mutex);
+                ht__concurrent_unlock(&shard->mutex);
+                spin_count = 0;
+            }
+            continue;
+        }
+
+        /* Copy the table first, all its fields (buckets, capacity, etc.) must come from the same state
+           so that probing stays within the buckets, even if their content is modified meanwhile.
+           The buckets themselves are never released while readers might use them. */
+        ht snapshot;
+        memcpy(&snapshot, (const void*)&shard->table, sizeof(ht));
+        ht__concurrent_acquire_fence();
+        if (ht__concurrent_load_acquire(&shard->sequence) != sequence)
+            continue;
+
+        void* found = ht__find_item(&snapshot, item, hash);
+        if (found && result)
+            memcpy(result, found, snapshot.sizeof_item);
+
+        ht__concurrent_acquire_fence();
+        if (ht__concurrent_load_acquire(&shard->sequence) == sequence)
+            return found != 0;
+    }
+}
+
+HT_API void
+ht_concurrent_init(ht_concurrent* c,
+    ht_size_t sizeof_item,
+    ht_hash_function_t hash,
+    ht_predicate_t items_are_same,
+    ht_size_t shard_count,
+    const ht_options* options)
+{
+    HT_ASSERT(shard_count);
+
+    ht_options shard_options;
+    if (options)
+        shard_options = *options;
+    else
+        ht_options_init(&shard_options);
+
+    HT_ASSERT(!shard_options.incremental_resize);
+    HT_ASSERT(!shard_options.allocator.allocate);
+
+    /* Memory is never reallocated in place, it's allocated and copied so that readers can still read the previous one. */
+    shard_options.allocator.allocate = ht__concurrent_alloc;
+    shard_options.allocator.reallocate = 0;
+    shard_options.allocator.deallocate = ht__concurrent_retire;
+
+    c->shard_count = ht__next_power_of_two(shard_count);
+    c->shard_shift = ht__shard_shift(c->shard_count);
+
+    c->shards = (ht_concurrent_shard*)HT_MALLOC(c->shard_count * sizeof(ht_concurrent_shard));
+    HT_ASSERT(c->shards);
+
+    for (ht_size_t i = 0; i < c->shard_count; ++i)
+    {
+        ht_concurrent_shard* shard = &c->shards[i];
+        memset(shard, 0, sizeof(ht_concurrent_shard));
+        ht__concurrent_mutex_init(&shard->mutex);
+
+        shard_options.allocator.context = shard;
+        ht_init_ex(&shard->table, sizeof_item, hash, items_are_same, 0, 0, &shard_options);
+    }
+}
+
+HT_API void
+ht_concurrent_destroy(ht_concurrent* c)
+{
+    for (ht_size_t i = 0; i < c->shard_count; ++i)
+    {
+        ht_concurrent_shard* shard = &c->shards[i];
+        ht_destroy(&shard->table);
+        ht__concurrent_release_retired(shard);
+        HT_FREE(shard->retired);
+        ht__concurrent_mutex_destroy(&shard->mutex);
+    }
+
+    HT_FREE(c->shards);
+    memset(c, 0, sizeof(ht_concurrent));
+}
+
+HT_API ht_bool
+ht_concurrent_insert(ht_concurrent* c, void* item)
+{
+    ht_hash_t hash = ht__do_hash(&c->shards[0].table, item);
+    ht_concurrent_shard* shard = ht__concurrent_shard_of(c, hash);
+
+    ht__concurrent_begin_write(shard);
+    ht_bool inserted = ht_insert_h(&shard->table, item, hash);
+    ht__concurrent_end_write(shard);
+
+    return inserted;
+}
+
+HT_API ht_bool
+ht_concurrent_erase(ht_concurrent* c, void* item)
+{
+    ht_hash_t hash = ht__do_hash(&c->shards[0].table, item);
+    ht_concurrent_shard* shard = ht__concurrent_shard_of(c, hash);
+
+    ht__concurrent_begin_write(shard);
+    ht_bool erased = ht_erase_h(&shard->table, item, hash);
+    ht__concurrent_end_write(shard);
+
+    return erased;
+}
+
+HT_API ht_bool
+ht_concurrent_get(ht_concurrent* c, void* item, void* result)
+{
+    ht_hash_t hash = ht__do_hash(&c->shards[0].table, item);
+    return ht__concurrent_read(ht__concurrent_shard_of(c, hash), item, hash, result);
+}
+
+HT_API ht_bool
+ht_concurrent_contains(ht_concurrent* c, void* item)
+{
+    ht_hash_t hash = ht__do_hash(&c->shards[0].table, item);
+    return ht__concurrent_read(ht__concurrent_shard_of(c, hash), item, hash, 0);
+}
+
+HT_API ht_size_t
+ht_concurrent_size(ht_concurrent* c)
+{
+    ht_size_t size = 0;
+    for (ht_size_t i = 0; i < c->shard_count; ++i)
+    {
+        size += *(const volatile ht_size_t*)&c->shards[i].table.filled_bucket_count;
+    }
+    return size;
+}
+
+HT_API void
+ht_concurrent_collect(ht_concurrent* c)
+{
+    for (ht_size_t i = 0; i < c->shard_count; ++i)
+    {
+        ht_concurrent_shard* shard = &c->shards[i];
+        ht__concurrent_lock(&shard->mutex);
+        ht__concurrent_release_retired(shard);
+        ht__concurrent_unlock(&shard->mutex);
+    }
+}
+
+#endif /* defined(HT_IMPLEMENTATION) */
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE 1 - The MIT License (MIT)
+
+Copyright (c) 2024 kevreco
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE 2 - Public Domain (www.unlicense.org)
+
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <https://unlicense.org>
+------------------------------------------------------------------------------
+*/
\ No newline at end of file
@@ -0,0 +1,503 @@
+/*
+
+SUMMARY:
+
+    Save a hash table to a file and map it back into memory without inserting any item.
+    It's using ht.h
+
+    The file is a header followed by the memory of the table as it is (buckets, hashes, control bytes, distances),
+    so loading a table is a call to mmap, then pages are read from the file when they are first accessed.
+
+NOTES:
+
+    ht.h must be used.
+
+    Items must be plain data: pointers stored in items are meaningless once the file is mapped by another process.
+    The hash and comparison functions are not saved, they must be the same when the table is mapped.
+
+    A mapped table is read-only: lookups, cursors and ht_stats can be used but items must not be inserted or erased.
+    ht_destroy unmaps the file.
+
+    Files can only be mapped by a program built for the same integer size and endianness.
+
+    Memory mapping uses mmap, or MapViewOfFile on Windows.
+
+EXAMPLE:
+
+    // Build and save once.
+    FILE* file = fopen("table.bin", "wb");
+    ht_write_image(&h, fileno(file));
+    fclose(file);
+
+    // At each start.
+    ht mapped;
+    if (ht_map_image(&mapped, "table.bin", sizeof(struct item_t), hash, items_are_same))
+    {
+        struct item_t* found = ht_get_item(&mapped, &item);
+        ...
+        ht_destroy(&mapped);
+    }
+*/
+
+#ifndef RE_HT_IMAGE_H
+#define RE_HT_IMAGE_H
+
+#include "ht.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Write the table to a file descriptor opened for writing, returns true on success.
+   Pending incremental resize is completed first. */
+HT_API ht_bool ht_write_image(ht* h, int fd);
+
+/* Map a file written by ht_write_image, returns false if the file cannot be read
+   or was written with another item size or for another platform. */
+HT_API ht_bool ht_map_image(ht* h,
+    const char* path,
+    ht_size_t sizeof_item,
+    ht_hash_function_t hash,
+    ht_predicate_t items_are_same);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* RE_HT_IMAGE_H */
+
+#if defined(HT_IMPLEMENTATION) && !defined(RE_HT_IMAGE_IMPLEMENTATION)
+#define RE_HT_IMAGE_IMPLEMENTATION
+
+#include <string.h> /* memcpy, memset, memcmp */
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <io.h> /* _write */
+#else
+#include <fcntl.h>    /* open */
+#include <sys/mman.h> /* mmap, munmap */
+#include <sys/stat.h> /* fstat */
+#include <unistd.h>   /* write, close */
+#endif
+
+#define HT_IMAGE_MAGIC "RE_HTIMG"
+#define HT_IMAGE_VERSION 1
+#define HT_IMAGE_ENDIANNESS 0x01020304u
+
+/* Size of the header, the buckets following it are aligned for any item. */
+#define HT_IMAGE_HEADER_SIZE 128
+
+typedef struct ht__image_header ht__image_header;
+struct ht__image_header {
+    char magic[8];
+    unsigned int version;
+    unsigned int endianness;  /* HT_IMAGE_ENDIANNESS as written by the CPU */
+    ht_size_t sizeof_size;    /* sizeof(ht_size_t), which is also the size of the hashes */
+    ht_size_t sizeof_item;
+    ht_size_t separate_metadata;
+    ht_size_t bucket_capacity;
+    ht_size_t filled_bucket_count;
+    ht_size_t max_distance;
+    ht_size_t memory_size;    /* bytes following the header */
+    ht_size_t growth_factor;
+    ht_size_t min_capacity;
+    float max_load;
+    float min_load;
+};
+
+typedef union ht__image_header_block ht__image_header_block;
+union ht__image_header_block {
+    ht__image_header header;
+    char bytes[HT_IMAGE_HEADER_SIZE];
+};
+
+#if defined(_WIN32)
+
+static ht_bool
+ht__image_write(int fd, const void* data, ht_size_t size)
+{
+    const char* p = (const char*)data;
+    while (size)
+    {
+        unsigned int chunk = size > 0x40000000 ? 0x40000000 : (unsigned int)size;
+        int written = _write(fd, p, chunk);
+        if (written <= 0)
+            return 0;
+        p += written;
+        size -= (ht_size_t)written;
+    }
+    return 1;
+}
+
+/* Returns the whole file, or null. */
+static void*
+ht__image_map(const char* path, ht_size_t* size)
+{
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+        return 0;
+
+    void* base = 0;
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+    {
+        /* The view keeps the mapping alive once its handle is closed. */
+        HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+        if (mapping)
+        {
+            base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        *size = (ht_size_t)file_size.QuadPart;
+    }
+
+    CloseHandle(file);
+    return base;
+}
+
+static void
+ht__image_unmap(void* base, ht_size_t size)
+{
+    (void)size;
+    UnmapViewOfFile(base);
+}
+
+#else
+
+static ht_bool
+ht__image_write(int fd, const void* data, ht_size_t size)
+{
+    const char* p = (const char*)data;
+    while (size)
+    {
+        ssize_t written = write(fd, p, size);
+        if (written <= 0)
+            return 0;
+        p += written;
+        size -= (ht_size_t)written;
+    }
+    return 1;
+}
+
+/* Returns the whole file, or null. */
+static void*
+ht__image_map(const char* path, ht_size_t* size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    void* base = 0;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        base = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED)
+            base = 0;
+        *size = (ht_size_t)st.st_size;
+    }
+
+    /* The mapping stays valid once the file is closed. */
+    close(fd);
+    return base;
+}
+
+static void
+ht__image_unmap(void* base, ht_size_t size)
+{
+    munmap(base, size);
+}
+
+#endif
+
+/* Allocator of a mapped table, nothing is allocated since the table is read-only. */
+static void*
+ht__image_alloc(void* context, ht_size_t size)
+{
+    (void)context;
+    (void)size;
+    HT_ASSERT(0 && "items must not be inserted in a mapped table");
+    return 0;
+}
+
+/* ptr are the buckets, right after the header. */
+static void
+ht__image_release(void* context, void* ptr, ht_size_t size)
+{
+    (void)context;
+    ht__image_unmap((char*)ptr - HT_IMAGE_HEADER_SIZE, size + HT_IMAGE_HEADER_SIZE);
+}
+
+/* Writes are gathered in a buffer so that there is one system call per HT_IMAGE_BUFFER_SIZE bytes. */
+typedef struct ht__image_writer ht__image_writer;
+struct ht__image_writer {
+    int fd;
+    char* buffer;
+    ht_size_t used;
+    ht_bool failed;
+};
+
+#define HT_IMAGE_BUFFER_SIZE (1 << 20)
+
+static void
+ht__image_flush(ht__image_writer* w)
+{
+    if (!w->failed && w->used)
+        w->failed = !ht__image_write(w->fd, w->buffer, w->used);
+    w->used = 0;
+}
+
+/* Append 'size' bytes of 'data', or zeros if 'data' is null. */
+static void
+ht__image_append(ht__image_writer* w, const void* data, ht_size_t size)
+{
+    const char* p = (const char*)data;
+    while (size)
+    {
+        if (w->used == HT_IMAGE_BUFFER_SIZE)
+            ht__image_flush(w);
+
+        ht_size_t chunk = HT_IMAGE_BUFFER_SIZE - w->used;
+        if (chunk > size)
+            chunk = size;
+
+        if (p)
+        {
+            memcpy(w->buffer + w->used, p, chunk);
+            p += chunk;
+        }
+        else
+        {
+            memset(w->buffer + w->used, 0, chunk);
+        }
+
+        w->used += chunk;
+        size -= chunk;
+    }
+}
+
+/* Append an array of buckets or hashes, empty ones are written as zeros:
+   they are never initialized and could contain anything (previous items for instance). */
+static void
+ht__image_append_array(ht* h, ht__image_writer* w, const ht_byte_t* array, ht_size_t stride)
+{
+    ht_size_t index = 0;
+    while (index < h->bucket_capacity)
+    {
+        /* Consecutive buckets in the same state are appended at once. */
+        ht_bool empty = ht__bucket_is_empty_at(h, index);
+        ht_size_t end = index + 1;
+        while (end < h->bucket_capacity && ht__bucket_is_empty_at(h, end) == empty)
+            end += 1;
+
+        ht__image_append(w, empty ? 0 : array + index * stride, (end - index) * stride);
+        index = end;
+    }
+}
+
+HT_API ht_bool
+ht_write_image(ht* h, int fd)
+{
+    ht__finish_migration(h);
+
+    ht__image_header_block block;
+    memset(&block, 0, sizeof(block));
+
+    ht__image_header* header = &block.header;
+    memcpy(header->magic, HT_IMAGE_MAGIC, sizeof(header->magic));
+    header->version = HT_IMAGE_VERSION;
+    header->endianness = HT_IMAGE_ENDIANNESS;
+    header->sizeof_size = sizeof(ht_size_t);
+    header->sizeof_item = h->sizeof_item;
+    header->separate_metadata = h->separate_metadata;
+    header->bucket_capacity = h->bucket_capacity;
+    header->filled_bucket_count = h->filled_bucket_count;
+    header->max_distance = h->max_distance;
+    header->memory_size = h->bucket_capacity ? h->allocated_memory : 0;
+    header->growth_factor = h->growth_factor;
+    header->min_capacity = h->min_capacity;
+    header->max_load = h->max_load;
+    header->min_load = h->min_load;
+
+    ht__image_writer w;
+    w.fd = fd;
+    w.buffer = (char*)HT_MALLOC(HT_IMAGE_BUFFER_SIZE);
+    w.used = 0;
+    w.failed = 0;
+    HT_ASSERT(w.buffer);
+
+    ht__image_append(&w, &block, sizeof(block));
+
+    if (h->bucket_capacity)
+    {
+        /* Same layout as the memory of the table, see ht__memory_size. */
+        ht__image_append_array(h, &w, h->buckets, h->sizeof_bucket);
+        if (h->separate_metadata)
+            ht__image_append_array(h, &w, h->hashes, sizeof(ht_hash_t));
+
+        /* Temporary entries. */
+        ht__image_append(&w, 0, 2 * h->sizeof_bucket);
+
+        ht__image_append(&w, h->ctrl, h->bucket_capacity);
+        ht__image_append(&w, h->distances, h->bucket_capacity);
+    }
+
+    ht__image_flush(&w);
+    HT_FREE(w.buffer);
+
+    return !w.failed;
+}
+
+static ht_bool
+ht__image_is_power_of_two(ht_size_t v)
+{
+    return v != 0 && (v & (v - 1)) == 0;
+}
+
+/* The header is read from a file which might be corrupt, every value used by the table is checked
+   so that the asserts of ht_init_ex are never reached and lookups stay within the mapped memory. */
+static ht_bool
+ht__image_header_is_valid(const ht__image_header* header, ht_size_t file_size, ht_size_t sizeof_item)
+{
+    if (memcmp(header->magic, HT_IMAGE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != HT_IMAGE_VERSION
+        || header->endianness != HT_IMAGE_ENDIANNESS
+        || header->sizeof_size != sizeof(ht_size_t)
+        || header->sizeof_item != sizeof_item
+        || header->memory_size != file_size - HT_IMAGE_HEADER_SIZE
+        || header->separate_metadata > 1)
+        return 0;
+
+    /* Comparisons are false for NaN. */
+    if (!(header->max_load >= 0.0f && header->max_load < 1.0f))
+        return 0;
+    float max_load = header->max_load > 0.0f ? header->max_load : DEFAULT_MAX_LOAD;
+    if (!(header->min_load >= 0.0f && header->min_load < max_load / 2))
+        return 0;
+
+    /* Written normalized by ht_init_ex. */
+    if (!ht__image_is_power_of_two(header->growth_factor) || header->growth_factor < 2
+        || !ht__image_is_power_of_two(header->min_capacity))
+        return 0;
+
+    if (header->bucket_capacity == 0)
+        return header->filled_bucket_count == 0 && header->max_distance == 0;
+
+    /* Each bucket takes at least its control byte and its distance, this also prevents overflows of the memory size. */
+    return ht__image_is_power_of_two(header->bucket_capacity)
+        && header->bucket_capacity <= header->memory_size / 2
+        && header->filled_bucket_count < header->bucket_capacity
+        && header->max_distance < header->bucket_capacity;
+}
+
+HT_API ht_bool
+ht_map_image(ht* h,
+    const char* path,
+    ht_size_t sizeof_item,
+    ht_hash_function_t hash,
+    ht_predicate_t items_are_same)
+{
+    ht_size_t file_size = 0;
+    char* base = (char*)ht__image_map(path, &file_size);
+    if (!base)
+        return 0;
+
+    ht__image_header header;
+    ht_bool valid = file_size >= HT_IMAGE_HEADER_SIZE;
+    if (valid)
+    {
+        memcpy(&header, base, sizeof(header));
+        valid = ht__image_header_is_valid(&header, file_size, sizeof_item);
+    }
+
+    if (valid)
+    {
+        ht_options options;
+        ht_options_init(&options);
+        options.separate_metadata = header.separate_metadata != 0;
+        options.max_load = header.max_load;
+        options.min_load = header.min_load;
+        options.growth_factor = header.growth_factor;
+        options.min_capacity = header.min_capacity;
+        options.allocator.allocate = ht__image_alloc;
+        options.allocator.deallocate = ht__image_release;
+
+        ht_init_ex(h, sizeof_item, hash, items_are_same, 0, 0, &options);
+
+        /* The memory size also depends on the bucket size, which depends on the platform. */
+        valid = header.bucket_capacity == 0 || ht__memory_size(h, header.bucket_capacity) == header.memory_size;
+    }
+
+    if (!valid || header.bucket_capacity == 0)
+    {
+        ht__image_unmap(base, file_size);
+        return valid;
+    }
+
+    ht__assign_memory(h, base + HT_IMAGE_HEADER_SIZE, header.bucket_capacity);
+    h->filled_bucket_count = header.filled_bucket_count;
+    h->max_distance = header.max_distance;
+
+    return 1;
+}
+
+#endif /* defined(HT_IMPLEMENTATION) */
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE 1 - The MIT License (MIT)
+
+Copyright (c) 2024 kevreco
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE 2 - Public Domain (www.unlicense.org)
+
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <https://unlicense.org>
+------------------------------------------------------------------------------
+*/
\ No newline at end of file
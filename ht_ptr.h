@@ -10,7 +10,7 @@ SUMMARY:
 NOTES:
 
     ht.h must be used.
-    There is no smart hashing done on the pointer and the default hash is definitly not the best for pointer use.
+    By default pointers are hashed with re_hash_ptr (hash.h) and compared by address.
 */
 
 #ifndef RE_HT_PTR_H
@@ -18,12 +18,18 @@ NOTES:
 
 
 #include "ht.h"
+#include "hash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 typedef struct ht_ptr_handle ht_ptr_handle;
 struct ht_ptr_handle {
     void* ptr;
 };
 
+/* hash and items_are_same can be null to hash and compare the addresses. */
 HT_API void ht_ptr_init(ht* h, ht_hash_function_t hash, ht_predicate_t items_are_same);
 
 HT_API void ht_ptr_destroy(ht* h);
@@ -35,7 +41,7 @@ HT_API void ht_ptr_insert(ht* h, void* ptr);
 HT_API void* ht_ptr_get(ht* h, void* key_ptr);
 
 /* Remove pointer. Return true if it was removed. */
-HT_API bool ht_ptr_remove(ht* h, void* ptr);
+HT_API ht_bool ht_ptr_remove(ht* h, void* ptr);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -52,13 +58,25 @@ static void swap_ptrs(ht_ptr_handle* left, ht_ptr_handle* right)
     *right = tmp;
 }
 
+static ht_hash_t
+ht__ptr_hash(ht_ptr_handle* handle)
+{
+    return (ht_hash_t)re_hash_ptr(handle->ptr);
+}
+
+static ht_bool
+ht__ptrs_are_same(ht_ptr_handle* left, ht_ptr_handle* right)
+{
+    return left->ptr == right->ptr;
+}
+
 HT_API void
 ht_ptr_init(ht* h, ht_hash_function_t hash, ht_predicate_t items_are_same)
 {
     ht_init(h,
         sizeof(ht_ptr_handle),
-        hash,
-        items_are_same,
+        hash ? hash : (ht_hash_function_t)ht__ptr_hash,
+        items_are_same ? items_are_same : (ht_predicate_t)ht__ptrs_are_same,
         (ht_swap_function_t)swap_ptrs,
         0);
 }
@@ -80,14 +98,14 @@ HT_API void*
 ht_ptr_get(ht* h, void* key_ptr)
 {
     ht_ptr_handle handle = { key_ptr };
-    ht_ptr_handle* result = ht_get_item(h, &handle);
+    ht_ptr_handle* result = (ht_ptr_handle*)ht_get_item(h, &handle);
 
     return result
         ? result->ptr
         : NULL;
 }
 
-HT_API bool
+HT_API ht_bool
 ht_ptr_remove(ht* h, void* ptr)
 {
     ht_ptr_handle handle = { ptr };
@@ -0,0 +1,460 @@
+/*
+
+SUMMARY:
+
+    Hash table split in several independent ht, to build big tables with several threads.
+    It's using ht.h
+    
+    Items are spread in shards according to the high bits of their hash, each shard is a ht.
+    A lookup computes the hash once and selects the shard with a shift.
+    Since shards do not share anything, each one can be filled by a different thread without any lock.
+
+NOTES:
+
+    ht.h must be used.
+
+    ht_sharded_insert_many hashes the items and builds the shards with several threads.
+    Shards can also be filled directly from your own threads, with ht_sharded_shard and ht_insert_h,
+    as long as a shard is only used by one thread at a time.
+
+    Threads are pthreads, or Windows threads on Windows. They can be disabled with:
+        #define HT_SHARDED_NO_THREADS
+
+    Use more shards than threads (4 times the number of threads for instance) so that the work is well balanced.
+
+EXAMPLE:
+
+    ht_sharded s;
+    ht_sharded_init(&s, sizeof(struct item_t), hash, items_are_same, 64, 0);
+
+    ht_sharded_insert_many(&s, items, item_count, 16);
+
+    struct item_t* found = ht_sharded_get_item(&s, &item);
+
+    ht_sharded_destroy(&s);
+*/
+
+#ifndef RE_HT_SHARDED_H
+#define RE_HT_SHARDED_H
+
+#include "ht.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ht_sharded ht_sharded;
+struct ht_sharded {
+    ht* shards;
+    ht_size_t shard_count;    /* power of two */
+    unsigned int shard_shift; /* shard of a hash is (hash >> shard_shift) & (shard_count - 1) */
+};
+
+/* shard_count is rounded up to a power of two, options can be null. */
+HT_API void ht_sharded_init(ht_sharded* s,
+    ht_size_t sizeof_item,
+    ht_hash_function_t hash,
+    ht_predicate_t items_are_same,
+    ht_size_t shard_count,
+    const ht_options* options);
+
+HT_API void ht_sharded_destroy(ht_sharded* s);
+
+/* Hash of an item, the same for the routing and for the shards. */
+HT_API ht_hash_t ht_sharded_hash(const ht_sharded* s, void* item);
+/* Index of the shard holding the items of this hash. */
+HT_API ht_size_t ht_sharded_shard_index(const ht_sharded* s, ht_hash_t hash);
+/* Shard holding the items of this hash. */
+HT_API ht* ht_sharded_shard(const ht_sharded* s, ht_hash_t hash);
+
+/* Returns true if item was inserted, false if item was replaced. */
+HT_API ht_bool ht_sharded_insert(ht_sharded* s, void* item);
+/* Insert contiguous items, shards are built in parallel by thread_count threads (the calling thread included).
+   Returns the number of items inserted, replaced items are not counted. */
+HT_API ht_size_t ht_sharded_insert_many(ht_sharded* s, const void* items, ht_size_t count, ht_size_t thread_count);
+/* Delete item, returns true if it was deleted. */
+HT_API ht_bool ht_sharded_erase(ht_sharded* s, void* item);
+/* Returns item found or NULL. */
+HT_API void* ht_sharded_get_item(const ht_sharded* s, void* item);
+HT_API ht_bool ht_sharded_contains(const ht_sharded* s, void* item);
+/* Number of items of all shards. */
+HT_API ht_size_t ht_sharded_size(const ht_sharded* s);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* RE_HT_SHARDED_H */
+
+#if defined(HT_IMPLEMENTATION) && !defined(RE_HT_SHARDED_IMPLEMENTATION)
+#define RE_HT_SHARDED_IMPLEMENTATION
+
+#include <string.h> /* memset */
+
+/* Below this number of items per thread, starting a thread costs more than it saves. */
+#define HT_SHARDED_MIN_ITEMS_PER_THREAD 4096
+
+/* Work of one thread in ht_sharded_insert_many. */
+typedef struct ht__sharded_worker ht__sharded_worker;
+struct ht__sharded_worker {
+    ht_sharded* s;
+    const ht_byte_t* items;
+    ht_size_t count;
+    ht_hash_t* hashes;         /* hash of each item */
+    ht_size_t* order;          /* indices of the items grouped by shard */
+    ht_size_t* shard_offsets;  /* items of shard i are in order[shard_offsets[i] .. shard_offsets[i + 1]] */
+    ht_size_t thread_index;
+    ht_size_t thread_count;
+    int building;              /* 0 when hashing the items, 1 when building the shards */
+    ht_size_t inserted;
+};
+
+static void
+ht__sharded_work(ht__sharded_worker* w)
+{
+    ht_sharded* s = w->s;
+    ht_size_t sizeof_item = s->shards[0].sizeof_item;
+
+    if (!w->building)
+    {
+        /* Each thread hashes a contiguous range of items. */
+        ht_size_t first = w->count * w->thread_index / w->thread_count;
+        ht_size_t last = w->count * (w->thread_index + 1) / w->thread_count;
+
+        for (ht_size_t i = first; i < last; ++i)
+            w->hashes[i] = ht__do_hash(&s->shards[0], w->items + i * sizeof_item);
+
+        return;
+    }
+
+    /* Each thread builds every thread_count-th shard. */
+    for (ht_size_t shard_index = w->thread_index; shard_index < s->shard_count; shard_index += w->thread_count)
+    {
+        ht* shard = &s->shards[shard_index];
+        ht_size_t first = w->shard_offsets[shard_index];
+        ht_size_t last = w->shard_offsets[shard_index + 1];
+
+        /* Sized for the item count and the max load, the shard does not grow during the loop. */
+        ht__reserve_many(shard, last - first);
+
+        for (ht_size_t i = first; i < last; ++i)
+        {
+            ht_size_t item_index = w->order[i];
+            if (ht_insert_h(shard, (void*)(w->items + item_index * sizeof_item), w->hashes[item_index]))
+                w->inserted += 1;
+        }
+    }
+}
+
+#if defined(HT_SHARDED_NO_THREADS)
+
+static void
+ht__sharded_run(ht__sharded_worker* workers, ht_size_t thread_count)
+{
+    for (ht_size_t i = 0; i < thread_count; ++i)
+        ht__sharded_work(&workers[i]);
+}
+
+#else
+
+#if defined(_WIN32)
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+typedef HANDLE ht__sharded_thread;
+
+static DWORD WINAPI
+ht__sharded_thread_main(LPVOID worker)
+{
+    ht__sharded_work((ht__sharded_worker*)worker);
+    return 0;
+}
+
+static ht_bool
+ht__sharded_thread_start(ht__sharded_thread* thread, ht__sharded_worker* worker)
+{
+    *thread = CreateThread(0, 0, ht__sharded_thread_main, worker, 0, 0);
+    return *thread != 0;
+}
+
+static void
+ht__sharded_thread_join(ht__sharded_thread thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+#else
+
+#include <pthread.h>
+
+typedef pthread_t ht__sharded_thread;
+
+static void*
+ht__sharded_thread_main(void* worker)
+{
+    ht__sharded_work((ht__sharded_worker*)worker);
+    return 0;
+}
+
+static ht_bool
+ht__sharded_thread_start(ht__sharded_thread* thread, ht__sharded_worker* worker)
+{
+    return pthread_create(thread, 0, ht__sharded_thread_main, worker) == 0;
+}
+
+static void
+ht__sharded_thread_join(ht__sharded_thread thread)
+{
+    pthread_join(thread, 0);
+}
+
+#endif
+
+/* Run the first worker in the calling thread and the others in new threads. */
+static void
+ht__sharded_run(ht__sharded_worker* workers, ht_size_t thread_count)
+{
+    ht__sharded_thread* threads = (ht__sharded_thread*)HT_MALLOC(thread_count * sizeof(ht__sharded_thread));
+    ht_bool* started = (ht_bool*)HT_MALLOC(thread_count * sizeof(ht_bool));
+    HT_ASSERT(threads && started);
+
+    for (ht_size_t i = 1; i < thread_count; ++i)
+    {
+        started[i] = ht__sharded_thread_start(&threads[i], &workers[i]);
+        /* Do the work here if the thread could not be created. */
+        if (!started[i])
+            ht__sharded_work(&workers[i]);
+    }
+
+    ht__sharded_work(&workers[0]);
+
+    for (ht_size_t i = 1; i < thread_count; ++i)
+    {
+        if (started[i])
+            ht__sharded_thread_join(threads[i]);
+    }
+
+    HT_FREE(started);
+    HT_FREE(threads);
+}
+
+#endif /* defined(HT_SHARDED_NO_THREADS) */
+
+HT_API void
+ht_sharded_init(ht_sharded* s,
+    ht_size_t sizeof_item,
+    ht_hash_function_t hash,
+    ht_predicate_t items_are_same,
+    ht_size_t shard_count,
+    const ht_options* options)
+{
+    HT_ASSERT(shard_count);
+
+    s->shard_count = ht__next_power_of_two(shard_count);
+    s->shard_shift = ht__shard_shift(s->shard_count);
+
+    s->shards = (ht*)HT_MALLOC(s->shard_count * sizeof(ht));
+    HT_ASSERT(s->shards);
+
+    for (ht_size_t i = 0; i < s->shard_count; ++i)
+        ht_init_ex(&s->shards[i], sizeof_item, hash, items_are_same, 0, 0, options);
+}
+
+HT_API void
+ht_sharded_destroy(ht_sharded* s)
+{
+    for (ht_size_t i = 0; i < s->shard_count; ++i)
+        ht_destroy(&s->shards[i]);
+
+    HT_FREE(s->shards);
+    memset(s, 0, sizeof(ht_sharded));
+}
+
+HT_API ht_hash_t
+ht_sharded_hash(const ht_sharded* s, void* item)
+{
+    return ht__do_hash(&s->shards[0], item);
+}
+
+HT_API ht_size_t
+ht_sharded_shard_index(const ht_sharded* s, ht_hash_t hash)
+{
+    return ht__shard_index(hash, s->shard_shift, s->shard_count);
+}
+
+HT_API ht*
+ht_sharded_shard(const ht_sharded* s, ht_hash_t hash)
+{
+    return &s->shards[ht_sharded_shard_index(s, hash)];
+}
+
+HT_API ht_bool
+ht_sharded_insert(ht_sharded* s, void* item)
+{
+    ht_hash_t hash = ht_sharded_hash(s, item);
+    return ht_insert_h(ht_sharded_shard(s, hash), item, hash);
+}
+
+HT_API ht_size_t
+ht_sharded_insert_many(ht_sharded* s, const void* items, ht_size_t count, ht_size_t thread_count)
+{
+    if (count == 0)
+        return 0;
+
+    if (thread_count > s->shard_count)
+        thread_count = s->shard_count;
+    if (thread_count > count / HT_SHARDED_MIN_ITEMS_PER_THREAD)
+        thread_count = count / HT_SHARDED_MIN_ITEMS_PER_THREAD;
+    if (thread_count == 0)
+        thread_count = 1;
+
+    ht_hash_t* hashes = (ht_hash_t*)HT_MALLOC(count * sizeof(ht_hash_t));
+    ht_size_t* order = (ht_size_t*)HT_MALLOC(count * sizeof(ht_size_t));
+    ht_size_t* shard_offsets = (ht_size_t*)HT_MALLOC((s->shard_count + 1) * sizeof(ht_size_t));
+    ht__sharded_worker* workers = (ht__sharded_worker*)HT_MALLOC(thread_count * sizeof(ht__sharded_worker));
+    HT_ASSERT(hashes && order && shard_offsets && workers);
+
+    for (ht_size_t i = 0; i < thread_count; ++i)
+    {
+        ht__sharded_worker* w = &workers[i];
+        w->s = s;
+        w->items = (const ht_byte_t*)items;
+        w->count = count;
+        w->hashes = hashes;
+        w->order = order;
+        w->shard_offsets = shard_offsets;
+        w->thread_index = i;
+        w->thread_count = thread_count;
+        w->building = 0;
+        w->inserted = 0;
+    }
+
+    ht__sharded_run(workers, thread_count);
+
+    /* Group item indices by shard with a counting sort, shard_offsets[i + 1] is first used as the count of shard i. */
+    memset(shard_offsets, 0, (s->shard_count + 1) * sizeof(ht_size_t));
+    for (ht_size_t i = 0; i < count; ++i)
+        shard_offsets[ht__shard_index(hashes[i], s->shard_shift, s->shard_count) + 1] += 1;
+
+    for (ht_size_t i = 0; i < s->shard_count; ++i)
+        shard_offsets[i + 1] += shard_offsets[i];
+
+    /* shard_offsets[i] is used as the next position of shard i, it ends as the offset of shard i + 1. */
+    for (ht_size_t i = 0; i < count; ++i)
+    {
+        ht_size_t shard_index = ht__shard_index(hashes[i], s->shard_shift, s->shard_count);
+        order[shard_offsets[shard_index]] = i;
+        shard_offsets[shard_index] += 1;
+    }
+
+    for (ht_size_t i = s->shard_count; i > 0; --i)
+        shard_offsets[i] = shard_offsets[i - 1];
+    shard_offsets[0] = 0;
+
+    for (ht_size_t i = 0; i < thread_count; ++i)
+        workers[i].building = 1;
+
+    ht__sharded_run(workers, thread_count);
+
+    ht_size_t inserted = 0;
+    for (ht_size_t i = 0; i < thread_count; ++i)
+        inserted += workers[i].inserted;
+
+    HT_FREE(workers);
+    HT_FREE(shard_offsets);
+    HT_FREE(order);
+    HT_FREE(hashes);
+
+    return inserted;
+}
+
+HT_API ht_bool
+ht_sharded_erase(ht_sharded* s, void* item)
+{
+    ht_hash_t hash = ht_sharded_hash(s, item);
+    return ht_erase_h(ht_sharded_shard(s, hash), item, hash);
+}
+
+HT_API void*
+ht_sharded_get_item(const ht_sharded* s, void* item)
+{
+    ht_hash_t hash = ht_sharded_hash(s, item);
+    return ht_get_item_h(ht_sharded_shard(s, hash), item, hash);
+}
+
+HT_API ht_bool
+ht_sharded_contains(const ht_sharded* s, void* item)
+{
+    ht_hash_t hash = ht_sharded_hash(s, item);
+    return ht_contains_h(ht_sharded_shard(s, hash), item, hash);
+}
+
+HT_API ht_size_t
+ht_sharded_size(const ht_sharded* s)
+{
+    ht_size_t size = 0;
+    for (ht_size_t i = 0; i < s->shard_count; ++i)
+        size += ht_size(&s->shards[i]);
+    return size;
+}
+
+#endif /* defined(HT_IMPLEMENTATION) */
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE 1 - The MIT License (MIT)
+
+Copyright (c) 2024 kevreco
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE 2 - Public Domain (www.unlicense.org)
+
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <https://unlicense.org>
+------------------------------------------------------------------------------
+*/
\ No newline at end of file
@@ -204,7 +204,8 @@ STRV_API void* strv_memory_find(strv mem, strv pattern);
 
 #endif /* RE_STRV_H */
 
-#ifdef STRV_IMPLEMENTATION
+#if defined(STRV_IMPLEMENTATION) && !defined(RE_STRV_IMPLEMENTATION)
+#define RE_STRV_IMPLEMENTATION
 
 STRV_API strv
 strv_make(void)
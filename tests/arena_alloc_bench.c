@@ -0,0 +1,102 @@
+/*
+    Memory wasted by arena_alloc.h with many small nodes and a few big buffers,
+    this is not part of the tests run by main.c.
+
+    Build and run with:
+        cc -O2 tests/arena_alloc_bench.c -o arena_alloc_bench && ./arena_alloc_bench
+
+    "reserved" is the capacity of all chunks (the committed memory in reserve mode), "waste" is the part of it which is not requested by the user
+    (chunk headers, padding and the unused tail of the chunks).
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#define RE_AA_IMPLEMENTATION
+#include "../arena_alloc.h"
+
+#define NODE_COUNT (1 << 20)
+#define NODE_SIZE 48
+#define BUFFER_EVERY 1024 /* One big buffer every N nodes. */
+
+static double
+now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+static size_t
+reserved_bytes(re_arena* a)
+{
+    size_t total = 0;
+    re_chunk* lists[] = { a->first, a->large, a->large_free };
+    for (int i = 0; i < 3; ++i)
+    {
+        for (re_chunk* c = lists[i]; c; c = c->next)
+            total += c->capacity;
+    }
+    return total;
+}
+
+static void
+run(const char* label, size_t buffer_size, size_t large_threshold, size_t reserve_size)
+{
+    re_arena a;
+    re_arena_options options;
+    re_arena_options_init(&options);
+    options.chunk_max_capacity = 1024 * 1024;
+    options.large_threshold = large_threshold;
+    options.reserve_size = reserve_size;
+    re_arena_init_ex(&a, 4096, &options);
+
+    size_t requested = 0;
+    uint64_t checksum = 0;
+
+    double start = now_ms();
+    for (size_t i = 0; i < NODE_COUNT; ++i)
+    {
+        char* node = (char*)re_arena_alloc(&a, NODE_SIZE);
+        node[0] = (char)i;
+        checksum += (unsigned char)node[0];
+        requested += NODE_SIZE;
+
+        if (i % BUFFER_EVERY == BUFFER_EVERY - 1)
+        {
+            char* buffer = (char*)re_arena_alloc(&a, buffer_size);
+            buffer[buffer_size - 1] = (char)i;
+            checksum += (unsigned char)buffer[buffer_size - 1];
+            requested += buffer_size;
+        }
+    }
+    double elapsed = now_ms() - start;
+
+    size_t reserved = reserved_bytes(&a);
+    double waste = 100.0 * (double)(reserved - requested) / (double)reserved;
+
+    char title[96];
+    snprintf(title, sizeof(title), "%s, %zu KB buffers", label, buffer_size / 1024);
+    printf("%-44s %8.1f ms  requested %7.1f MB  reserved %7.1f MB  waste %5.1f%%  chunks %zu (%llu)\n",
+        title, elapsed, requested / (1024.0 * 1024.0), reserved / (1024.0 * 1024.0), waste,
+        re_arena_allocated_chunk_count(&a), (unsigned long long)checksum);
+
+    re_arena_destroy(&a);
+}
+
+int
+main(void)
+{
+    printf("%d nodes of %d bytes, one buffer every %d nodes, chunks up to 1 MB\n", NODE_COUNT, NODE_SIZE, BUFFER_EVERY);
+
+    size_t buffer_sizes[] = { 1024 * 1024, 300 * 1024, 64 * 1024 };
+    for (int i = 0; i < 3; ++i)
+    {
+        run("no threshold", buffer_sizes[i], 0, 0);
+        run("threshold 16 KB", buffer_sizes[i], 16 * 1024, 0);
+        run("reserve 64 GB", buffer_sizes[i], 0, (size_t)64 << 30);
+    }
+
+    return 0;
+}
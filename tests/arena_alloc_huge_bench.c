@@ -0,0 +1,131 @@
+/*
+    Random traversal of nodes allocated in an arena with and without huge pages,
+    this is not part of the tests run by main.c.
+
+    Build and run with:
+        cc -O2 tests/arena_alloc_huge_bench.c -o arena_alloc_huge_bench && ./arena_alloc_huge_bench
+
+    The number of nodes can be given in millions, 8 by default (about 512 MB):
+        ./arena_alloc_huge_bench 32
+
+    The nodes are linked in a random order so that each step of the traversal touches another page,
+    which is what happens in a big tree built in an arena and dominated by TLB misses.
+    On Linux the amount of memory backed by transparent huge pages is reported (AnonHugePages).
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RE_AA_IMPLEMENTATION
+#include "../arena_alloc.h"
+
+struct node {
+    struct node* next;
+    uint64_t payload[7];
+};
+
+static double
+now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+/* Memory of the process backed by transparent huge pages in KB, 0 if unknown. */
+static long
+anon_huge_pages_kb(void)
+{
+    long kb = 0;
+    FILE* f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f)
+        return 0;
+
+    char line[256];
+    while (fgets(line, sizeof(line), f))
+    {
+        if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1)
+            break;
+    }
+    fclose(f);
+    return kb;
+}
+
+static void
+run(const char* label, size_t node_count, size_t* order, int huge_pages, size_t reserve_size)
+{
+    re_arena a;
+    re_arena_options options;
+    re_arena_options_init(&options);
+    options.chunk_max_capacity = 64 * 1024 * 1024;
+    options.huge_pages = huge_pages;
+    options.reserve_size = reserve_size;
+    re_arena_init_ex(&a, 64 * 1024, &options);
+
+    struct node** nodes = (struct node**)malloc(node_count * sizeof(struct node*));
+
+    double start = now_ms();
+    for (size_t i = 0; i < node_count; ++i)
+    {
+        nodes[i] = (struct node*)re_arena_alloc(&a, sizeof(struct node));
+        nodes[i]->payload[0] = i;
+    }
+    double alloc_elapsed = now_ms() - start;
+
+    /* Link the nodes in a random order. */
+    for (size_t i = 0; i + 1 < node_count; ++i)
+        nodes[order[i]]->next = nodes[order[i + 1]];
+    nodes[order[node_count - 1]]->next = NULL;
+
+    long huge_kb = anon_huge_pages_kb();
+
+    start = now_ms();
+    uint64_t sum = 0;
+    for (struct node* n = nodes[order[0]]; n; n = n->next)
+        sum += n->payload[0];
+    double elapsed = now_ms() - start;
+
+    printf("%-22s alloc %7.1f ms  traversal %8.1f ms (%5.1f ns/node)  huge pages %7ld MB  (%llu)\n",
+        label, alloc_elapsed, elapsed, elapsed * 1000000.0 / (double)node_count, huge_kb / 1024,
+        (unsigned long long)sum);
+
+    free(nodes);
+    re_arena_destroy(&a);
+}
+
+int
+main(int argc, char** argv)
+{
+    long millions = argc > 1 ? atol(argv[1]) : 8;
+    if (millions < 1)
+        millions = 1;
+    size_t node_count = (size_t)millions * 1000 * 1000;
+
+    /* Random permutation, Fisher-Yates with a LCG. */
+    size_t* order = (size_t*)malloc(node_count * sizeof(size_t));
+    for (size_t i = 0; i < node_count; ++i)
+        order[i] = i;
+    uint64_t seed = 42;
+    for (size_t i = node_count - 1; i > 0; --i)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        size_t j = (size_t)((seed >> 33) % (i + 1));
+        size_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    printf("%zu nodes of %zu bytes (%.0f MB)\n", node_count, sizeof(struct node),
+        (double)(node_count * sizeof(struct node)) / (1024.0 * 1024.0));
+
+    run("chunks", node_count, order, 0, 0);
+    run("chunks, huge pages", node_count, order, 1, 0);
+    run("reserve", node_count, order, 0, (size_t)64 << 30);
+    run("reserve, huge pages", node_count, order, 1, (size_t)64 << 30);
+
+    free(order);
+    return 0;
+}
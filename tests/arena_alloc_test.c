@@ -6,10 +6,20 @@
 #include "../arena_alloc.h"
 
 static void arena_alloc_tests();
+static void arena_alloc_alignment_tests();
+static void arena_alloc_growth_tests();
+static void arena_alloc_large_tests();
+static void arena_alloc_reserve_tests();
+static void arena_alloc_huge_pages_tests();
 
 int arena_alloc_test()
 {
     RUNIT_RUN(arena_alloc_tests);
+    RUNIT_RUN(arena_alloc_alignment_tests);
+    RUNIT_RUN(arena_alloc_growth_tests);
+    RUNIT_RUN(arena_alloc_large_tests);
+    RUNIT_RUN(arena_alloc_reserve_tests);
+    RUNIT_RUN(arena_alloc_huge_pages_tests);
     
     return runit_fail == 0;
 }
@@ -67,8 +77,13 @@ static void arena_alloc_tests()
     
         RUNIT_ASSERT(a.last != NULL);
         RUNIT_ASSERT(a.first != NULL);
-        RUNIT_ASSERT(a.first != a.last);
+        RUNIT_ASSERT(a.large != NULL);
         RUNIT_ASSERT(mem != NULL);
+
+        /* The big item has its own chunk, the first chunk is still used. */
+        RUNIT_ASSERT(a.first == a.last);
+        mem = arena_calloc(&a, 16);
+        RUNIT_ASSERT(first_chunk->size == 64);
     
         re_arena_destroy(&a);
     }
@@ -147,3 +162,352 @@ static void arena_alloc_tests()
         re_arena_destroy(&a);
     }
 }
+
+static int is_aligned(void* ptr, size_t alignment)
+{
+    return ((size_t)ptr & (alignment - 1)) == 0;
+}
+
+static void arena_alloc_alignment_tests()
+{
+    re_arena a;
+
+    /* Natural alignment */
+    {
+        re_arena_init(&a, 4096);
+
+        char* str = (char*)re_arena_alloc(&a, 3);
+        char* c = (char*)re_arena_alloc(&a, 1);
+        RUNIT_ASSERT(c == str + 3); /* No padding for bytes. */
+
+        double* d = (double*)re_arena_alloc(&a, sizeof(double));
+        RUNIT_ASSERT(is_aligned(d, sizeof(double)));
+
+        re_arena_alloc(&a, 3);
+        void* triple = re_arena_alloc(&a, 3 * sizeof(int));
+        RUNIT_ASSERT(is_aligned(triple, sizeof(int)));
+
+        re_arena_alloc(&a, 1);
+        void* big = re_arena_alloc(&a, 100 * RE_AA_ALIGNMENT);
+        RUNIT_ASSERT(is_aligned(big, RE_AA_ALIGNMENT));
+
+        RUNIT_ASSERT(re_arena_allocated_chunk_count(&a) == 1);
+
+        re_arena_destroy(&a);
+    }
+
+    /* Explicit alignment, bigger than the alignment of the chunks. */
+    {
+        re_arena_init(&a, 64);
+
+        size_t alignments[] = { 1, 2, 8, 32, 64, 256, 4096 };
+        int all_aligned = 1;
+        for (int round = 0; round < 10; ++round)
+        {
+            for (int i = 0; i < 7; ++i)
+            {
+                re_arena_alloc(&a, 1);
+                char* mem = (char*)re_arena_alloc_aligned(&a, 40, alignments[i]);
+                memset(mem, 0xff, 40);
+                all_aligned = all_aligned && is_aligned(mem, alignments[i]);
+            }
+        }
+        RUNIT_ASSERT(all_aligned);
+
+        /* Reused chunks are aligned too. */
+        re_arena_clear(&a);
+        void* mem = re_arena_alloc_aligned(&a, 16, 4096);
+        RUNIT_ASSERT(is_aligned(mem, 4096));
+
+        re_arena_destroy(&a);
+    }
+}
+
+static void arena_alloc_growth_tests()
+{
+    re_arena a;
+    re_arena_options options;
+
+    /* Chunks double up to the max capacity. */
+    {
+        re_arena_options_init(&options);
+        options.chunk_max_capacity = 1024;
+        re_arena_init_ex(&a, 64, &options);
+
+        for (int i = 0; i < 200; ++i)
+            arena_calloc(&a, 16);
+
+        size_t expected_capacities[] = { 64, 128, 256, 512, 1024 };
+        int capacities_are_doubled = 1;
+        int index = 0;
+        for (re_chunk* c = a.first; c; c = c->next, ++index)
+        {
+            size_t expected = index < 5 ? expected_capacities[index] : 1024;
+            capacities_are_doubled = capacities_are_doubled && c->capacity == expected;
+        }
+        RUNIT_ASSERT(capacities_are_doubled);
+        /* 200 * 16 bytes fit in 64 + 128 + 256 + 512 + 1024 + 1024 + 1024 bytes (minus headers). */
+        RUNIT_ASSERT(re_arena_allocated_chunk_count(&a) == 7);
+
+        /* Cleared chunks are reused, no new chunk is needed. */
+        re_arena_clear(&a);
+        for (int i = 0; i < 200; ++i)
+            arena_calloc(&a, 16);
+        RUNIT_ASSERT(re_arena_allocated_chunk_count(&a) == 7);
+
+        re_arena_destroy(&a);
+    }
+
+    /* Capacities of several GB do not overflow, nothing is allocated. */
+    if (sizeof(size_t) > 4)
+    {
+        re_arena_options_init(&options);
+        options.chunk_max_capacity = (size_t)1 << 32;
+        re_arena_init_ex(&a, (size_t)1 << 30, &options);
+
+        RUNIT_ASSERT(compute_capacity_to_allocate(&a, 16) == (size_t)1 << 30);
+        RUNIT_ASSERT(compute_capacity_to_allocate(&a, 16) == (size_t)1 << 31);
+        RUNIT_ASSERT(compute_capacity_to_allocate(&a, 16) == (size_t)1 << 32);
+        RUNIT_ASSERT(compute_capacity_to_allocate(&a, 16) == (size_t)1 << 32);
+
+        re_arena_destroy(&a);
+    }
+
+    /* Without max capacity, all chunks have the min capacity. */
+    {
+        re_arena_init(&a, 64);
+
+        for (int i = 0; i < 20; ++i)
+            arena_calloc(&a, 32);
+
+        int all_min = 1;
+        for (re_chunk* c = a.first; c; c = c->next)
+            all_min = all_min && c->capacity == 64;
+        RUNIT_ASSERT(all_min);
+        RUNIT_ASSERT(re_arena_allocated_chunk_count(&a) == 20);
+
+        re_arena_destroy(&a);
+    }
+
+    /* Oversized allocations do not waste the rest of the current chunk. */
+    {
+        re_arena_init(&a, 1024);
+
+        char* small = (char*)arena_calloc(&a, 16);
+        re_chunk* current = a.last;
+
+        char* big = (char*)arena_calloc(&a, 5000);
+        RUNIT_ASSERT(big != NULL);
+        RUNIT_ASSERT(a.last == current);
+        RUNIT_ASSERT(current->next == NULL);
+        RUNIT_ASSERT(a.large->capacity < 8192); /* Not rounded up to a power of two. */
+
+        char* next_small = (char*)arena_calloc(&a, 16);
+        RUNIT_ASSERT(next_small == small + 16);
+
+        /* Big allocation first. */
+        re_arena_destroy(&a);
+        re_arena_init(&a, 1024);
+        big = (char*)arena_calloc(&a, 5000);
+        small = (char*)arena_calloc(&a, 16);
+        RUNIT_ASSERT(big && small);
+        RUNIT_ASSERT(re_arena_allocated_chunk_count(&a) == 2);
+
+        re_arena_destroy(&a);
+    }
+}
+
+static void arena_alloc_large_tests()
+{
+    re_arena a;
+    re_arena_options options;
+
+    /* Allocations above the threshold get their own chunk even if they fit in the current one. */
+    {
+        re_arena_options_init(&options);
+        options.large_threshold = 256;
+        re_arena_init_ex(&a, 4096, &options);
+
+        char* small = (char*)arena_calloc(&a, 16);
+        char* big = (char*)arena_calloc(&a, 512);
+        char* next_small = (char*)arena_calloc(&a, 16);
+        char* medium = (char*)arena_calloc(&a, 256);
+
+        RUNIT_ASSERT(a.large != NULL && a.large->next == NULL);
+        RUNIT_ASSERT(big == (char*)a.large + RE_AA_SIZEOF_CHUNK_ALIGNED);
+        RUNIT_ASSERT(next_small == small + 16);
+        RUNIT_ASSERT(medium == next_small + 16);
+        RUNIT_ASSERT(re_arena_allocated_chunk_count(&a) == 2);
+
+        re_arena_destroy(&a);
+        RUNIT_ASSERT(a.large == NULL && a.large_free == NULL);
+    }
+
+    /* Released large chunks are reused by large allocations which fit in them. */
+    {
+        re_arena_options_init(&options);
+        options.large_threshold = 256;
+        re_arena_init_ex(&a, 4096, &options);
+
+        arena_calloc(&a, 16);
+        char* big = (char*)arena_calloc(&a, 2000);
+        char* bigger = (char*)arena_calloc(&a, 8000);
+        RUNIT_ASSERT(re_arena_allocated_chunk_count(&a) == 3);
+
+        re_arena_clear(&a);
+        RUNIT_ASSERT(a.large == NULL && a.large_free != NULL);
+
+        /* The smallest chunk that fits is picked. */
+        RUNIT_ASSERT(arena_calloc(&a, 1000) == big);
+        RUNIT_ASSERT(arena_calloc(&a, 3000) == bigger);
+        arena_calloc(&a, 1000);
+        RUNIT_ASSERT(re_arena_allocated_chunk_count(&a) == 4);
+
+        re_arena_destroy(&a);
+    }
+
+    /* Rollback releases the large chunks allocated after the saved state. */
+    {
+        re_arena_options_init(&options);
+        options.large_threshold = 256;
+        re_arena_init_ex(&a, 4096, &options);
+
+        char* before = (char*)arena_calloc(&a, 1000);
+        re_arena_state s = re_arena_save_state(&a);
+        arena_calloc(&a, 1000);
+        arena_calloc(&a, 16);
+        RUNIT_ASSERT(a.large->next != NULL);
+
+        re_arena_rollback_state(&a, s);
+        RUNIT_ASSERT(a.large != NULL && a.large->next == NULL);
+        RUNIT_ASSERT(before == (char*)a.large + RE_AA_SIZEOF_CHUNK_ALIGNED);
+        RUNIT_ASSERT(a.large_free != NULL);
+        RUNIT_ASSERT(a.first->size == RE_AA_SIZEOF_CHUNK_ALIGNED);
+
+        re_arena_destroy(&a);
+    }
+}
+
+static void arena_alloc_reserve_tests()
+{
+    re_arena a;
+    re_arena_options options;
+
+    /* Allocations are contiguous in a single chunk, pages are committed as needed. */
+    {
+        re_arena_options_init(&options);
+        options.reserve_size = (size_t)1 << 30;
+        options.large_threshold = 256; /* Ignored in reserve mode. */
+        re_arena_init_ex(&a, 4096, &options);
+        RUNIT_ASSERT(a.first == NULL);
+
+        char* first = (char*)arena_calloc(&a, 100);
+        RUNIT_ASSERT(a.first != NULL && a.first == a.last);
+        RUNIT_ASSERT(a.first->capacity == a.commit_size);
+
+        int contiguous = 1;
+        char* previous = first;
+        for (int i = 0; i < 10000; ++i)
+        {
+            char* mem = (char*)arena_calloc(&a, 100);
+            contiguous = contiguous && mem == previous + 100;
+            previous = mem;
+        }
+        RUNIT_ASSERT(contiguous);
+
+        char* big = (char*)arena_calloc(&a, 3 * 1024 * 1024 + 4);
+        RUNIT_ASSERT(big == previous + 100);
+        RUNIT_ASSERT(a.large == NULL);
+        RUNIT_ASSERT(re_arena_allocated_chunk_count(&a) == 1);
+        RUNIT_ASSERT(a.first->capacity >= a.first->size);
+        RUNIT_ASSERT(a.first->capacity % a.commit_size == 0);
+
+        void* aligned = re_arena_alloc_aligned(&a, 16, 4096);
+        RUNIT_ASSERT(is_aligned(aligned, 4096));
+
+        /* Rollback and clear keep the same range. */
+        re_arena_state s = re_arena_save_state(&a);
+        arena_calloc(&a, 100);
+        re_arena_rollback_state(&a, s);
+        RUNIT_ASSERT(arena_calloc(&a, 16) == (char*)aligned + 16);
+
+        size_t committed = a.first->capacity;
+        re_arena_clear(&a);
+        RUNIT_ASSERT(a.first->capacity == committed);
+        RUNIT_ASSERT(arena_calloc(&a, 100) == first);
+
+        re_arena_destroy(&a);
+        RUNIT_ASSERT(a.first == NULL && a.last == NULL);
+    }
+
+    /* Clear decommits the pages above the threshold. */
+    {
+        re_arena_options_init(&options);
+        options.reserve_size = (size_t)1 << 30;
+        options.decommit_threshold = 64 * 1024;
+        re_arena_init_ex(&a, 4096, &options);
+
+        char* mem = (char*)re_arena_alloc(&a, 1024 * 1024);
+        memset(mem, 0xff, 1024 * 1024);
+        RUNIT_ASSERT(a.first->capacity > 1024 * 1024);
+
+        re_arena_clear(&a);
+        RUNIT_ASSERT(a.first->capacity == 64 * 1024);
+
+        /* Pages are committed again, decommitted pages are zeroed. */
+        RUNIT_ASSERT(re_arena_alloc(&a, 1024 * 1024) == mem);
+        RUNIT_ASSERT(mem[0] == (char)0xff);
+        RUNIT_ASSERT(mem[1024 * 1024 - 1] == 0);
+
+        re_arena_destroy(&a);
+    }
+}
+
+static void arena_alloc_huge_pages_tests()
+{
+    re_arena a;
+    re_arena_options options;
+
+    /* Chunks are aligned on huge pages and their capacity is a multiple of it. */
+    {
+        re_arena_options_init(&options);
+        options.huge_pages = 1;
+        options.chunk_max_capacity = 4096;
+        re_arena_init_ex(&a, 4096, &options);
+
+        char* small = (char*)arena_calloc(&a, 16);
+        RUNIT_ASSERT(a.first->capacity == RE_AA_HUGE_PAGE_SIZE);
+
+        /* Bigger than a huge page, it gets a large chunk. */
+        char* big = (char*)arena_calloc(&a, RE_AA_HUGE_PAGE_SIZE + 16);
+        RUNIT_ASSERT(a.large != NULL);
+        RUNIT_ASSERT(a.large->capacity == 2 * RE_AA_HUGE_PAGE_SIZE);
+        RUNIT_ASSERT(arena_calloc(&a, 16) == small + 16);
+
+#ifndef _WIN32
+        RUNIT_ASSERT(is_aligned(a.first, RE_AA_HUGE_PAGE_SIZE));
+        RUNIT_ASSERT(is_aligned(a.large, RE_AA_HUGE_PAGE_SIZE));
+#endif
+        RUNIT_ASSERT(big != NULL);
+
+        re_arena_destroy(&a);
+    }
+
+    /* The reserved range is committed by multiple of huge pages. */
+    {
+        re_arena_options_init(&options);
+        options.huge_pages = 1;
+        options.reserve_size = (size_t)1 << 30;
+        re_arena_init_ex(&a, 4096, &options);
+
+        arena_calloc(&a, 16);
+        RUNIT_ASSERT(a.first->capacity == RE_AA_HUGE_PAGE_SIZE);
+        arena_calloc(&a, RE_AA_HUGE_PAGE_SIZE);
+        RUNIT_ASSERT(a.first->capacity == 2 * RE_AA_HUGE_PAGE_SIZE);
+#ifndef _WIN32
+        RUNIT_ASSERT(is_aligned(a.first, RE_AA_HUGE_PAGE_SIZE));
+#endif
+
+        re_arena_destroy(&a);
+    }
+}
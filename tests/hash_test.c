@@ -0,0 +1,147 @@
+#include "hash_test.h"
+
+#include "runit.h"
+
+#include "../strv.h"
+#include "../hash.h"
+
+#define HT_IMPLEMENTATION
+#include "../ht_ptr.h"
+
+static void hash_bytes_tests();
+static void hash_distribution_tests();
+static void hash_ht_ptr_tests();
+
+int hash_test()
+{
+    RUNIT_RUN(hash_bytes_tests);
+    RUNIT_RUN(hash_distribution_tests);
+    RUNIT_RUN(hash_ht_ptr_tests);
+
+    return runit_fail == 0;
+}
+
+static void hash_bytes_tests()
+{
+    unsigned char bytes[300];
+    unsigned char unaligned[301];
+    for (int i = 0; i < 300; ++i)
+        bytes[i] = (unsigned char)(i * 7);
+    memcpy(unaligned + 1, bytes, sizeof(bytes));
+
+    /* Every length gives a different hash, and the address of the data does not matter. */
+    uint64_t hashes[301];
+    int all_same_unaligned = 1;
+    for (int size = 0; size <= 300; ++size)
+    {
+        hashes[size] = re_hash_bytes(bytes, size);
+        all_same_unaligned = all_same_unaligned && hashes[size] == re_hash_bytes(unaligned + 1, size);
+    }
+    RUNIT_ASSERT(all_same_unaligned);
+
+    int all_different = 1;
+    for (int i = 0; i <= 300; ++i)
+        for (int j = i + 1; j <= 300; ++j)
+            all_different = all_different && hashes[i] != hashes[j];
+    RUNIT_ASSERT(all_different);
+
+    /* Any modified byte changes the hash, in each path (short, 16 bytes blocks, 48 bytes blocks). */
+    int sizes[] = { 3, 8, 16, 40, 100, 300 };
+    int all_changed = 1;
+    for (int s = 0; s < 6; ++s)
+    {
+        for (int i = 0; i < sizes[s]; ++i)
+        {
+            bytes[i] ^= 1;
+            all_changed = all_changed && re_hash_bytes(bytes, sizes[s]) != hashes[sizes[s]];
+            bytes[i] ^= 1;
+        }
+    }
+    RUNIT_ASSERT(all_changed);
+
+    RUNIT_ASSERT(re_hash_bytes_seed(bytes, 10, 1) != re_hash_bytes_seed(bytes, 10, 2));
+    RUNIT_ASSERT(re_hash_str("hello") == re_hash_bytes("hello", 5));
+
+    strv sv = { 5, "hello world" };
+    RUNIT_ASSERT(re_hash_strv(sv) == re_hash_str("hello"));
+}
+
+#define DISTRIBUTION_KEY_COUNT (1 << 14)
+#define DISTRIBUTION_BUCKET_COUNT (1 << 10)
+
+/* Largest number of hashes in the same bucket, in the low bits (bucket index) and in the top bits (fingerprint). */
+static int max_low_bits_load(const uint64_t* hashes)
+{
+    static int loads[DISTRIBUTION_BUCKET_COUNT];
+    memset(loads, 0, sizeof(loads));
+
+    int max_load = 0;
+    for (int i = 0; i < DISTRIBUTION_KEY_COUNT; ++i)
+    {
+        int load = ++loads[hashes[i] & (DISTRIBUTION_BUCKET_COUNT - 1)];
+        max_load = load > max_load ? load : max_load;
+    }
+    return max_load;
+}
+
+static int max_top_bits_load(const uint64_t* hashes)
+{
+    int loads[128] = { 0 };
+
+    int max_load = 0;
+    for (int i = 0; i < DISTRIBUTION_KEY_COUNT; ++i)
+    {
+        int load = ++loads[hashes[i] >> 57];
+        max_load = load > max_load ? load : max_load;
+    }
+    return max_load;
+}
+
+static void hash_distribution_tests()
+{
+    /* Keys with many zero low bits would all be in the same bucket with an identity hash,
+       16 keys per bucket are expected, 128 per fingerprint. */
+    static uint64_t hashes[DISTRIBUTION_KEY_COUNT];
+
+    for (int i = 0; i < DISTRIBUTION_KEY_COUNT; ++i)
+        hashes[i] = re_hash_u32((uint32_t)i << 16);
+    RUNIT_ASSERT(max_low_bits_load(hashes) < 40);
+    RUNIT_ASSERT(max_top_bits_load(hashes) < 200);
+
+    for (int i = 0; i < DISTRIBUTION_KEY_COUNT; ++i)
+        hashes[i] = re_hash_u64((uint64_t)i << 40);
+    RUNIT_ASSERT(max_low_bits_load(hashes) < 40);
+    RUNIT_ASSERT(max_top_bits_load(hashes) < 200);
+
+    /* Addresses of 64 bytes objects, they are never dereferenced. */
+    for (int i = 0; i < DISTRIBUTION_KEY_COUNT; ++i)
+        hashes[i] = re_hash_ptr((const char*)(uintptr_t)0x7f0000001000ull + (size_t)i * 64);
+    RUNIT_ASSERT(max_low_bits_load(hashes) < 40);
+    RUNIT_ASSERT(max_top_bits_load(hashes) < 200);
+
+    for (int i = 0; i < DISTRIBUTION_KEY_COUNT; ++i)
+    {
+        char key[32];
+        int size = snprintf(key, sizeof(key), "key_%d", i);
+        hashes[i] = re_hash_bytes(key, size);
+    }
+    RUNIT_ASSERT(max_low_bits_load(hashes) < 40);
+    RUNIT_ASSERT(max_top_bits_load(hashes) < 200);
+}
+
+static void hash_ht_ptr_tests()
+{
+    int values[100];
+    ht h;
+    ht_ptr_init(&h, 0, 0);
+
+    for (int i = 0; i < 100; ++i)
+        ht_ptr_insert(&h, &values[i]);
+
+    RUNIT_ASSERT(ht_size(&h) == 100);
+    RUNIT_ASSERT(ht_ptr_get(&h, &values[42]) == &values[42]);
+    RUNIT_ASSERT(ht_ptr_remove(&h, &values[42]));
+    RUNIT_ASSERT(ht_ptr_get(&h, &values[42]) == 0);
+
+    ht_ptr_destroy(&h);
+}
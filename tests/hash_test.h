@@ -0,0 +1,14 @@
+#ifndef RE_HASH_TEST_H
+#define RE_HASH_TEST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int hash_test();
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* RE_HASH_TEST_H */
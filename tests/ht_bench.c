@@ -0,0 +1,541 @@
+/*
+    Benchmarks for ht.h, this is not part of the tests run by main.c.
+
+    Build and run with:
+        cc -O2 tests/ht_bench.c -o ht_bench && ./ht_bench
+
+    Compare with the scalar probing with:
+        cc -O2 -DHT_NO_SIMD tests/ht_bench.c -o ht_bench_scalar && ./ht_bench_scalar
+
+    A single benchmark can be run by giving its name, this is needed to get a meaningful peak memory:
+        ./ht_bench grow-rebuild
+        ./ht_bench grow-in-place
+
+    Worst insert time with and without ht_options.incremental_resize:
+        ./ht_bench insert-latency
+
+    Random lookups one by one and with ht_get_items_batch:
+        ./ht_bench batch-lookups
+
+    Building a table with ht_insert, ht_insert_many and ht_insert_many_sorted:
+        ./ht_bench insert-many
+
+    Inserting in a reserved table for items from 8B to 256B:
+        ./ht_bench insert-sizes
+
+    Loading a table by inserting all items compared to mapping a file written by ht_write_image:
+        ./ht_bench image
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/resource.h> /* getrusage */
+#endif
+
+#define HT_IMPLEMENTATION
+#include "../ht.h"
+#include "../ht_image.h"
+
+#ifdef _WIN32
+#define fileno _fileno
+#endif
+
+/* Table is filled up to the max load (0.75) */
+#define BENCH_CAPACITY (1 << 20)
+#define BENCH_COUNT ((BENCH_CAPACITY / 4) * 3)
+
+struct small_item {
+    uint64_t key;
+};
+
+struct big_item {
+    uint64_t key;
+    char payload[120];
+};
+
+static ht_hash_t
+mix64(uint64_t x)
+{
+    /* splitmix64 finalizer */
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (ht_hash_t)x;
+}
+
+/* Both items start with the key so the same callbacks are used. */
+static ht_hash_t
+hash_key(uint64_t* key)
+{
+    return mix64(*key);
+}
+
+static ht_bool
+keys_are_same(uint64_t* left, uint64_t* right)
+{
+    return *left == *right;
+}
+
+static ht_bool
+u64_are_same(uint64_t left, uint64_t right)
+{
+    return left == right;
+}
+
+static double
+now_ms(void)
+{
+    return (double)clock() * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static void
+fill(ht* h, ht_size_t sizeof_item, ht_bool separate_metadata)
+{
+    ht_options options;
+    ht_options_init(&options);
+    options.separate_metadata = separate_metadata;
+
+    ht_init_ex(h, sizeof_item, (ht_hash_function_t)hash_key, (ht_predicate_t)keys_are_same, 0, BENCH_CAPACITY, &options);
+
+    struct big_item item;
+    memset(&item, 0, sizeof(item));
+    for (uint64_t i = 0; i < BENCH_COUNT; ++i)
+    {
+        item.key = i;
+        ht_insert(h, &item);
+    }
+}
+
+static void
+bench_lookups(const char* name, ht_size_t sizeof_item, ht_bool separate_metadata)
+{
+    ht h;
+    fill(&h, sizeof_item, separate_metadata);
+
+    struct big_item item;
+    memset(&item, 0, sizeof(item));
+    size_t found = 0;
+
+    double start = now_ms();
+    for (int round = 0; round < 10; ++round)
+    {
+        for (uint64_t i = 0; i < BENCH_COUNT; ++i)
+        {
+            item.key = i;
+            found += ht_contains(&h, &item);
+        }
+    }
+    double positive_ms = now_ms() - start;
+
+    start = now_ms();
+    for (int round = 0; round < 10; ++round)
+    {
+        for (uint64_t i = 0; i < BENCH_COUNT; ++i)
+        {
+            item.key = BENCH_COUNT + i;
+            found += ht_contains(&h, &item);
+        }
+    }
+    double negative_ms = now_ms() - start;
+
+    printf("%-28s positive: %8.1f ms, negative: %8.1f ms (found %zu)\n", name, positive_ms, negative_ms, found);
+
+    ht_destroy(&h);
+}
+
+/* Peak resident memory of the process in MB, 0 if unknown. */
+static double
+peak_memory_mb(void)
+{
+#ifndef _WIN32
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double)usage.ru_maxrss / 1024.0; /* ru_maxrss is in KB on Linux */
+#else
+    return 0.0;
+#endif
+}
+
+#define GROW_CAPACITY (1 << 22)
+#define GROW_COUNT ((GROW_CAPACITY / 4) * 3)
+
+struct grow_item {
+    uint64_t key;
+    uint64_t value;
+};
+
+static void
+fill_for_grow(ht* h)
+{
+    ht_init(h, sizeof(struct grow_item), (ht_hash_function_t)hash_key, (ht_predicate_t)keys_are_same, 0, GROW_CAPACITY);
+
+    struct grow_item item;
+    for (uint64_t i = 0; i < GROW_COUNT; ++i)
+    {
+        item.key = i;
+        item.value = i;
+        ht_insert(h, &item);
+    }
+}
+
+/* Growth as it was done before: a second table is filled by inserting all items of the first one. */
+static void
+bench_grow_rebuild(void)
+{
+    ht h;
+    fill_for_grow(&h);
+    double before_mb = peak_memory_mb();
+
+    double start = now_ms();
+
+    ht new_h;
+    ht_init(&new_h, h.sizeof_item, h.hash, h.items_are_same, h.swap_items, h.bucket_capacity * 2);
+
+    ht_cursor cursor;
+    ht_cursor_init(&h, &cursor);
+    while (ht_cursor_next(&cursor))
+    {
+        ht_insert(&new_h, ht_cursor_item(&cursor));
+    }
+    ht_swap(&h, &new_h);
+    ht_destroy(&new_h);
+
+    double elapsed_ms = now_ms() - start;
+
+    printf("%-28s %8.1f ms, peak memory: %8.1f MB (%8.1f MB before growing)\n", "grow by rebuilding", elapsed_ms, peak_memory_mb(), before_mb);
+
+    ht_destroy(&h);
+}
+
+static void
+bench_grow_in_place(void)
+{
+    ht h;
+    fill_for_grow(&h);
+    double before_mb = peak_memory_mb();
+
+    double start = now_ms();
+    ht_reserve(&h, h.bucket_capacity * 2);
+    double elapsed_ms = now_ms() - start;
+
+    printf("%-28s %8.1f ms, peak memory: %8.1f MB (%8.1f MB before growing)\n", "grow in place", elapsed_ms, peak_memory_mb(), before_mb);
+
+    ht_destroy(&h);
+}
+
+/* Slowest single insert while growing from an empty table. */
+static void
+bench_insert_latency(const char* name, ht_bool incremental_resize)
+{
+    ht h;
+    ht_options options;
+    ht_options_init(&options);
+    options.incremental_resize = incremental_resize;
+    ht_init_ex(&h, sizeof(struct grow_item), (ht_hash_function_t)hash_key, (ht_predicate_t)keys_are_same, 0, 0, &options);
+
+    double worst_ms = 0.0;
+    double start = now_ms();
+
+    struct grow_item item;
+    for (uint64_t i = 0; i < GROW_COUNT; ++i)
+    {
+        item.key = i;
+        item.value = i;
+
+        double insert_start = now_ms();
+        ht_insert(&h, &item);
+        double insert_ms = now_ms() - insert_start;
+
+        if (insert_ms > worst_ms)
+            worst_ms = insert_ms;
+    }
+
+    double elapsed_ms = now_ms() - start;
+
+    printf("%-28s total: %8.1f ms, worst insert: %8.3f ms\n", name, elapsed_ms, worst_ms);
+
+    ht_destroy(&h);
+}
+
+static void
+bench_all_insert_latency(void)
+{
+    printf("ht insert latency, %d items\n", GROW_COUNT);
+
+    bench_insert_latency("grow at once", 0);
+    bench_insert_latency("grow incrementally", 1);
+}
+
+#define BATCH_LOOKUP_COUNT (1 << 16)
+
+/* Random lookups in a table bigger than the caches. */
+static void
+bench_batch_lookups(void)
+{
+    ht h;
+    fill_for_grow(&h);
+
+    static struct grow_item keys[BATCH_LOOKUP_COUNT];
+    static void* items[BATCH_LOOKUP_COUNT];
+    for (uint64_t i = 0; i < BATCH_LOOKUP_COUNT; ++i)
+    {
+        /* Half of the keys are missing. */
+        keys[i].key = mix64(i) % (GROW_COUNT * 2);
+    }
+
+    size_t found = 0;
+    double start = now_ms();
+    for (int round = 0; round < 50; ++round)
+    {
+        for (uint64_t i = 0; i < BATCH_LOOKUP_COUNT; ++i)
+        {
+            found += ht_get_item(&h, &keys[i]) != 0;
+        }
+    }
+    double single_ms = now_ms() - start;
+
+    start = now_ms();
+    for (int round = 0; round < 50; ++round)
+    {
+        ht_get_items_batch(&h, keys, BATCH_LOOKUP_COUNT, sizeof(struct grow_item), items);
+        for (uint64_t i = 0; i < BATCH_LOOKUP_COUNT; ++i)
+        {
+            found += items[i] != 0;
+        }
+    }
+    double batch_ms = now_ms() - start;
+
+    printf("ht random lookups, %d items, %d keys, 50 rounds\n", GROW_COUNT, BATCH_LOOKUP_COUNT);
+    printf("%-28s %8.1f ms\n", "one by one", single_ms);
+    printf("%-28s %8.1f ms (found %zu)\n", "batch", batch_ms, found);
+
+    ht_destroy(&h);
+}
+
+typedef ht_size_t (*insert_many_t)(ht* h, const void* items, ht_size_t count);
+
+static void
+bench_insert_many(const char* name, struct grow_item* items, insert_many_t insert_many)
+{
+    ht h;
+    ht_init(&h, sizeof(struct grow_item), (ht_hash_function_t)hash_key, (ht_predicate_t)keys_are_same, 0, 0);
+
+    double start = now_ms();
+    if (insert_many)
+    {
+        insert_many(&h, items, GROW_COUNT);
+    }
+    else
+    {
+        for (uint64_t i = 0; i < GROW_COUNT; ++i)
+        {
+            ht_insert(&h, &items[i]);
+        }
+    }
+    double elapsed_ms = now_ms() - start;
+
+    printf("%-28s %8.1f ms (%zu items)\n", name, elapsed_ms, (size_t)ht_size(&h));
+
+    ht_destroy(&h);
+}
+
+static void
+bench_all_insert_many(void)
+{
+    struct grow_item* items = (struct grow_item*)malloc(GROW_COUNT * sizeof(struct grow_item));
+    for (uint64_t i = 0; i < GROW_COUNT; ++i)
+    {
+        items[i].key = i;
+        items[i].value = i;
+    }
+
+    printf("ht build from an array of %d items\n", GROW_COUNT);
+
+    bench_insert_many("ht_insert", items, 0);
+    bench_insert_many("ht_insert_many", items, ht_insert_many);
+    bench_insert_many("ht_insert_many_sorted", items, ht_insert_many_sorted);
+
+    free(items);
+}
+
+static void
+bench_all_insert_sizes(void)
+{
+    ht_size_t sizes[] = { 8, 16, 32, 64, 128, 256 };
+    uint64_t item[256 / sizeof(uint64_t)];
+    memset(item, 0, sizeof(item));
+
+    printf("ht inserts in a reserved table, %d items at 0.75 load, 5 rounds\n", BENCH_COUNT);
+
+    for (size_t size_index = 0; size_index < sizeof(sizes) / sizeof(sizes[0]); ++size_index)
+    {
+        ht h;
+        ht_init(&h, sizes[size_index], (ht_hash_function_t)hash_key, (ht_predicate_t)keys_are_same, 0, BENCH_CAPACITY);
+
+        double elapsed_ms = 0.0;
+        for (int round = 0; round < 5; ++round)
+        {
+            ht_clear(&h);
+
+            double start = now_ms();
+            for (uint64_t i = 0; i < BENCH_COUNT; ++i)
+            {
+                item[0] = i;
+                ht_insert(&h, item);
+            }
+            elapsed_ms += now_ms() - start;
+        }
+
+        printf("%3zuB items %17s %8.1f ms\n", (size_t)sizes[size_index], "", elapsed_ms);
+
+        ht_destroy(&h);
+    }
+}
+
+HT_DEFINE(u64_map, uint64_t, uint64_t, mix64, u64_are_same)
+
+/* Same as bench_lookups with 8B items, with a table generated by HT_DEFINE. */
+static void
+bench_define_lookups(void)
+{
+    u64_map m;
+    u64_map_init(&m);
+    u64_map_reserve(&m, BENCH_CAPACITY);
+
+    for (uint64_t i = 0; i < BENCH_COUNT; ++i)
+    {
+        u64_map_insert(&m, i, i);
+    }
+
+    size_t found = 0;
+
+    double start = now_ms();
+    for (int round = 0; round < 10; ++round)
+    {
+        for (uint64_t i = 0; i < BENCH_COUNT; ++i)
+        {
+            found += u64_map_contains(&m, i);
+        }
+    }
+    double positive_ms = now_ms() - start;
+
+    start = now_ms();
+    for (int round = 0; round < 10; ++round)
+    {
+        for (uint64_t i = 0; i < BENCH_COUNT; ++i)
+        {
+            found += u64_map_contains(&m, BENCH_COUNT + i);
+        }
+    }
+    double negative_ms = now_ms() - start;
+
+    printf("%-28s positive: %8.1f ms, negative: %8.1f ms (found %zu)\n", "HT_DEFINE(uint64_t)", positive_ms, negative_ms, found);
+
+    u64_map_destroy(&m);
+}
+
+static void
+bench_all_lookups(void)
+{
+    printf("ht lookups, group width: %d, %d items at 0.75 load, 10 rounds\n", HT_GROUP_WIDTH, BENCH_COUNT);
+
+    bench_lookups("8B items", sizeof(struct small_item), 0);
+    bench_lookups("8B items, separate hashes", sizeof(struct small_item), 1);
+    bench_lookups("128B items", sizeof(struct big_item), 0);
+    bench_lookups("128B items, separate hashes", sizeof(struct big_item), 1);
+    bench_define_lookups();
+}
+
+#define BENCH_IMAGE_PATH "ht_bench_image.bin"
+
+static void
+bench_image(void)
+{
+    struct big_item* items = (struct big_item*)malloc(BENCH_COUNT * sizeof(struct big_item));
+    memset(items, 0, BENCH_COUNT * sizeof(struct big_item));
+    for (uint64_t i = 0; i < BENCH_COUNT; ++i)
+    {
+        items[i].key = i;
+    }
+
+    printf("ht load of %d 128B items\n", BENCH_COUNT);
+
+    ht h;
+    ht_init(&h, sizeof(struct big_item), (ht_hash_function_t)hash_key, (ht_predicate_t)keys_are_same, 0, 0);
+
+    double start = now_ms();
+    ht_insert_many(&h, items, BENCH_COUNT);
+    printf("%-28s %8.1f ms\n", "ht_insert_many", now_ms() - start);
+
+    FILE* file = fopen(BENCH_IMAGE_PATH, "wb");
+    start = now_ms();
+    ht_write_image(&h, fileno(file));
+    fclose(file);
+    printf("%-28s %8.1f ms\n", "ht_write_image", now_ms() - start);
+    ht_destroy(&h);
+
+    /* Lookups of a few keys, pages of the file are only read when they are accessed. */
+    ht mapped;
+    size_t found = 0;
+    start = now_ms();
+    ht_map_image(&mapped, BENCH_IMAGE_PATH, sizeof(struct big_item), (ht_hash_function_t)hash_key, (ht_predicate_t)keys_are_same);
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        uint64_t key = mix64(i) % BENCH_COUNT;
+        found += ht_contains(&mapped, &key);
+    }
+    printf("%-28s %8.1f ms (found %zu)\n", "ht_map_image + 1000 keys", now_ms() - start, found);
+    ht_destroy(&mapped);
+
+    /* Lookups of all keys, all pages are read. */
+    found = 0;
+    start = now_ms();
+    ht_map_image(&mapped, BENCH_IMAGE_PATH, sizeof(struct big_item), (ht_hash_function_t)hash_key, (ht_predicate_t)keys_are_same);
+    for (uint64_t i = 0; i < BENCH_COUNT; ++i)
+    {
+        found += ht_contains(&mapped, &i);
+    }
+    printf("%-28s %8.1f ms (found %zu)\n", "ht_map_image + all keys", now_ms() - start, found);
+    ht_destroy(&mapped);
+
+    remove(BENCH_IMAGE_PATH);
+    free(items);
+}
+
+typedef struct bench bench;
+struct bench {
+    const char* name;
+    void (*run)(void);
+};
+
+static bench benches[] = {
+    { "lookups", bench_all_lookups },
+    { "grow-rebuild", bench_grow_rebuild },
+    { "grow-in-place", bench_grow_in_place },
+    { "insert-latency", bench_all_insert_latency },
+    { "batch-lookups", bench_batch_lookups },
+    { "insert-many", bench_all_insert_many },
+    { "insert-sizes", bench_all_insert_sizes },
+    { "image", bench_image },
+};
+
+int main(int argc, char** argv)
+{
+    size_t bench_count = sizeof(benches) / sizeof(benches[0]);
+
+    for (size_t i = 0; i < bench_count; ++i)
+    {
+        if (argc < 2 || strcmp(argv[1], benches[i].name) == 0)
+        {
+            benches[i].run();
+        }
+    }
+
+    return 0;
+}
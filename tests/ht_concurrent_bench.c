@@ -0,0 +1,212 @@
+/*
+    Read throughput of ht_concurrent.h compared to a ht behind a global mutex,
+    this is not part of the tests run by main.c.
+
+    Build and run with:
+        cc -O2 -pthread tests/ht_concurrent_bench.c -o ht_concurrent_bench && ./ht_concurrent_bench
+
+    The max number of reader threads can be given, it's the number of cores by default:
+        ./ht_concurrent_bench 32
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h> /* sysconf */
+
+#define HT_IMPLEMENTATION
+#include "../ht_concurrent.h"
+
+#define ITEM_COUNT (1 << 20)
+#define LOOKUPS_PER_THREAD (1 << 22)
+
+struct item {
+    uint64_t key;
+    uint64_t value;
+};
+
+static ht_hash_t
+hash_item(struct item* item)
+{
+    /* splitmix64 finalizer */
+    uint64_t x = item->key;
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (ht_hash_t)x;
+}
+
+static ht_bool
+items_are_same(struct item* left, struct item* right)
+{
+    return left->key == right->key;
+}
+
+static double
+now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+static ht locked_table;
+static pthread_mutex_t table_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ht_concurrent concurrent_table;
+static volatile int writer_running;
+
+typedef struct reader reader;
+struct reader {
+    pthread_t thread;
+    uint64_t seed;
+    uint64_t found;
+};
+
+static uint64_t
+next_key(uint64_t* seed)
+{
+    *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (*seed >> 33) % ITEM_COUNT;
+}
+
+static void*
+read_locked(void* arg)
+{
+    reader* r = (reader*)arg;
+    struct item item = { 0, 0 };
+    struct item result;
+
+    for (int i = 0; i < LOOKUPS_PER_THREAD; ++i)
+    {
+        item.key = next_key(&r->seed);
+        pthread_mutex_lock(&table_mutex);
+        r->found += ht_get(&locked_table, &item, &result);
+        pthread_mutex_unlock(&table_mutex);
+    }
+    return 0;
+}
+
+static void*
+read_concurrent(void* arg)
+{
+    reader* r = (reader*)arg;
+    struct item item = { 0, 0 };
+    struct item result;
+
+    for (int i = 0; i < LOOKUPS_PER_THREAD; ++i)
+    {
+        item.key = next_key(&r->seed);
+        r->found += ht_concurrent_get(&concurrent_table, &item, &result);
+    }
+    return 0;
+}
+
+/* Replace items until readers are done. */
+static void*
+write_locked(void* arg)
+{
+    (void)arg;
+    uint64_t seed = 42;
+    struct item item;
+    while (__atomic_load_n(&writer_running, __ATOMIC_ACQUIRE))
+    {
+        item.key = next_key(&seed);
+        item.value = item.key;
+        pthread_mutex_lock(&table_mutex);
+        ht_insert(&locked_table, &item);
+        pthread_mutex_unlock(&table_mutex);
+    }
+    return 0;
+}
+
+static void*
+write_concurrent(void* arg)
+{
+    (void)arg;
+    uint64_t seed = 42;
+    struct item item;
+    while (__atomic_load_n(&writer_running, __ATOMIC_ACQUIRE))
+    {
+        item.key = next_key(&seed);
+        item.value = item.key;
+        ht_concurrent_insert(&concurrent_table, &item);
+    }
+    return 0;
+}
+
+static void
+run(const char* name, int thread_count, void* (*read)(void*), void* (*write)(void*))
+{
+    reader readers[256];
+    pthread_t writer;
+
+    if (write)
+    {
+        writer_running = 1;
+        pthread_create(&writer, 0, write, 0);
+    }
+
+    double start = now_ms();
+    for (int i = 0; i < thread_count; ++i)
+    {
+        readers[i].seed = (uint64_t)i + 1;
+        readers[i].found = 0;
+        pthread_create(&readers[i].thread, 0, read, &readers[i]);
+    }
+
+    uint64_t found = 0;
+    for (int i = 0; i < thread_count; ++i)
+    {
+        pthread_join(readers[i].thread, 0);
+        found += readers[i].found;
+    }
+    double elapsed_ms = now_ms() - start;
+
+    if (write)
+    {
+        __atomic_store_n(&writer_running, 0, __ATOMIC_RELEASE);
+        pthread_join(writer, 0);
+    }
+
+    double lookups = (double)thread_count * LOOKUPS_PER_THREAD;
+    printf("%-28s %3d readers: %8.1f M lookups/s (found %llu)\n", name, thread_count, lookups / elapsed_ms / 1000.0, (unsigned long long)found);
+}
+
+int main(int argc, char** argv)
+{
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > 256) max_threads = 256;
+
+    ht_init(&locked_table, sizeof(struct item), (ht_hash_function_t)hash_item, (ht_predicate_t)items_are_same, 0, 0);
+    ht_concurrent_init(&concurrent_table, sizeof(struct item), (ht_hash_function_t)hash_item, (ht_predicate_t)items_are_same, 64, 0);
+
+    struct item item;
+    for (uint64_t i = 0; i < ITEM_COUNT; ++i)
+    {
+        item.key = i;
+        item.value = i;
+        ht_insert(&locked_table, &item);
+        ht_concurrent_insert(&concurrent_table, &item);
+    }
+
+    printf("%d items, %d lookups per reader\n", ITEM_COUNT, LOOKUPS_PER_THREAD);
+
+    for (int thread_count = 1; thread_count <= max_threads; thread_count *= 2)
+    {
+        run("global mutex", thread_count, read_locked, 0);
+        run("ht_concurrent", thread_count, read_concurrent, 0);
+        run("global mutex, 1 writer", thread_count, read_locked, write_locked);
+        run("ht_concurrent, 1 writer", thread_count, read_concurrent, write_concurrent);
+    }
+
+    ht_destroy(&locked_table);
+    ht_concurrent_destroy(&concurrent_table);
+
+    return 0;
+}
@@ -0,0 +1,229 @@
+#include "ht_concurrent_test.h"
+
+#include "runit.h"
+
+#define HT_IMPLEMENTATION
+#include "../ht_concurrent.h"
+
+static void ht_concurrent_tests();
+#ifndef _WIN32
+static void ht_concurrent_stress_tests();
+#endif
+
+int ht_concurrent_test()
+{
+    RUNIT_RUN(ht_concurrent_tests);
+#ifndef _WIN32
+    RUNIT_RUN(ht_concurrent_stress_tests);
+#endif
+
+    return runit_fail == 0;
+}
+
+/* Value is always twice the key, so readers can detect a torn item. */
+struct pair {
+    unsigned int key;
+    unsigned int value;
+};
+
+static ht_bool pairs_are_same(struct pair* left, struct pair* right)
+{
+    return left->key == right->key;
+}
+
+static ht_hash_t pair_hash(struct pair* p)
+{
+    /* Spread keys over the high bits too, they select the shard. */
+    ht_hash_t h = (ht_hash_t)p->key * (ht_hash_t)0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+static void ht_concurrent_tests()
+{
+    ht_concurrent c;
+    ht_concurrent_init(&c, sizeof(struct pair), (ht_hash_function_t)pair_hash, (ht_predicate_t)pairs_are_same, 6, 0);
+
+    /* Rounded up to a power of two. */
+    RUNIT_ASSERT(c.shard_count == 8);
+
+    for (unsigned int i = 0; i < 1000; ++i)
+    {
+        struct pair p = { i, i * 2 };
+        ht_concurrent_insert(&c, &p);
+    }
+    RUNIT_ASSERT(ht_concurrent_size(&c) == 1000);
+
+    /* Items are spread in all shards. */
+    int all_shards_used = 1;
+    for (ht_size_t i = 0; i < c.shard_count; ++i)
+        all_shards_used = all_shards_used && ht_size(&c.shards[i].table) > 0;
+    RUNIT_ASSERT(all_shards_used);
+
+    struct pair key = { 10, 0 };
+    struct pair result = { 0, 0 };
+    RUNIT_ASSERT(ht_concurrent_get(&c, &key, &result));
+    RUNIT_ASSERT(result.key == 10 && result.value == 20);
+
+    struct pair replaced = { 10, 30 };
+    RUNIT_ASSERT(!ht_concurrent_insert(&c, &replaced));
+    RUNIT_ASSERT(ht_concurrent_get(&c, &key, &result));
+    RUNIT_ASSERT(result.value == 30);
+
+    RUNIT_ASSERT(ht_concurrent_erase(&c, &key));
+    RUNIT_ASSERT(!ht_concurrent_erase(&c, &key));
+    RUNIT_ASSERT(!ht_concurrent_contains(&c, &key));
+    RUNIT_ASSERT(ht_concurrent_size(&c) == 999);
+
+    /* Memory of the tables before they grew is kept until collected. */
+    RUNIT_ASSERT(c.shards[0].retired_count > 0);
+    ht_concurrent_collect(&c);
+    RUNIT_ASSERT(c.shards[0].retired_count == 0);
+
+    key.key = 999;
+    RUNIT_ASSERT(ht_concurrent_contains(&c, &key));
+
+    ht_concurrent_destroy(&c);
+}
+
+#ifndef _WIN32
+
+#include <pthread.h>
+
+#define STRESS_WRITER_COUNT 4
+#define STRESS_READER_COUNT 4
+#define STRESS_KEYS_PER_WRITER 20000
+
+typedef struct stress_context stress_context;
+struct stress_context {
+    ht_concurrent* c;
+    unsigned int first_key;
+    volatile int* writers_done;
+    unsigned int* progress; /* Number of keys inserted by each writer in its first round. */
+    int errors;
+    int missing;
+    unsigned long found;
+};
+
+/* Insert a range of keys, then erase half of them, several times. */
+static void* stress_writer(void* arg)
+{
+    stress_context* ctx = (stress_context*)arg;
+    unsigned int* progress = &ctx->progress[ctx->first_key / STRESS_KEYS_PER_WRITER];
+
+    for (int round = 0; round < 3; ++round)
+    {
+        for (unsigned int i = 0; i < STRESS_KEYS_PER_WRITER; ++i)
+        {
+            struct pair p = { ctx->first_key + i, (ctx->first_key + i) * 2 };
+            ht_concurrent_insert(ctx->c, &p);
+
+            if (round == 0)
+                __atomic_store_n(progress, i + 1, __ATOMIC_RELEASE);
+        }
+
+        for (unsigned int i = 0; i < STRESS_KEYS_PER_WRITER; i += 2)
+        {
+            struct pair p = { ctx->first_key + i, 0 };
+            ht_concurrent_erase(ctx->c, &p);
+        }
+    }
+
+    return 0;
+}
+
+/* Look up all keys until writers are done, found items must never be torn
+   and odd keys must be found once inserted since they are never erased. */
+static void* stress_reader(void* arg)
+{
+    stress_context* ctx = (stress_context*)arg;
+    unsigned int key_count = STRESS_WRITER_COUNT * STRESS_KEYS_PER_WRITER;
+    unsigned int key = ctx->first_key;
+
+    while (!__atomic_load_n(ctx->writers_done, __ATOMIC_ACQUIRE))
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            key = (key * 1103515245u + 12345u) % key_count;
+
+            /* Progress is read before the lookup, the key was inserted before if it's below. */
+            unsigned int index = key % STRESS_KEYS_PER_WRITER;
+            unsigned int inserted = __atomic_load_n(&ctx->progress[key / STRESS_KEYS_PER_WRITER], __ATOMIC_ACQUIRE);
+            int must_exist = (index & 1) && index < inserted;
+
+            struct pair p = { key, 0 };
+            struct pair result = { 0, 0 };
+            if (ht_concurrent_get(ctx->c, &p, &result))
+            {
+                ctx->found += 1;
+                if (result.key != key || result.value != key * 2)
+                    ctx->errors += 1;
+            }
+            else if (must_exist)
+            {
+                ctx->missing += 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void ht_concurrent_stress_tests()
+{
+    ht_concurrent c;
+    ht_concurrent_init(&c, sizeof(struct pair), (ht_hash_function_t)pair_hash, (ht_predicate_t)pairs_are_same, 4, 0);
+
+    volatile int writers_done = 0;
+    unsigned int progress[STRESS_WRITER_COUNT] = { 0 };
+    pthread_t writers[STRESS_WRITER_COUNT];
+    pthread_t readers[STRESS_READER_COUNT];
+    stress_context writer_contexts[STRESS_WRITER_COUNT];
+    stress_context reader_contexts[STRESS_READER_COUNT];
+
+    for (int i = 0; i < STRESS_READER_COUNT; ++i)
+    {
+        stress_context ctx = { &c, (unsigned int)i, &writers_done, progress, 0, 0, 0 };
+        reader_contexts[i] = ctx;
+        pthread_create(&readers[i], 0, stress_reader, &reader_contexts[i]);
+    }
+
+    for (int i = 0; i < STRESS_WRITER_COUNT; ++i)
+    {
+        stress_context ctx = { &c, (unsigned int)i * STRESS_KEYS_PER_WRITER, &writers_done, progress, 0, 0, 0 };
+        writer_contexts[i] = ctx;
+        pthread_create(&writers[i], 0, stress_writer, &writer_contexts[i]);
+    }
+
+    for (int i = 0; i < STRESS_WRITER_COUNT; ++i)
+        pthread_join(writers[i], 0);
+
+    __atomic_store_n(&writers_done, 1, __ATOMIC_RELEASE);
+
+    int errors = 0;
+    int missing = 0;
+    for (int i = 0; i < STRESS_READER_COUNT; ++i)
+    {
+        pthread_join(readers[i], 0);
+        errors += reader_contexts[i].errors;
+        missing += reader_contexts[i].missing;
+    }
+    RUNIT_ASSERT(errors == 0);
+    RUNIT_ASSERT(missing == 0);
+
+    /* Odd keys remain. */
+    unsigned int key_count = STRESS_WRITER_COUNT * STRESS_KEYS_PER_WRITER;
+    RUNIT_ASSERT(ht_concurrent_size(&c) == key_count / 2);
+
+    int only_odd_found = 1;
+    for (unsigned int i = 0; i < key_count; ++i)
+    {
+        struct pair p = { i, 0 };
+        only_odd_found = only_odd_found && (ht_concurrent_contains(&c, &p) == (ht_bool)(i % 2));
+    }
+    RUNIT_ASSERT(only_odd_found);
+
+    ht_concurrent_collect(&c);
+    ht_concurrent_destroy(&c);
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,245 @@
+#include "ht_image_test.h"
+
+#include <stdio.h>
+
+#include "runit.h"
+
+#define HT_IMPLEMENTATION
+#include "../ht_image.h"
+
+#ifdef _WIN32
+#define fileno _fileno
+#endif
+
+static void ht_image_tests();
+static void ht_image_invalid_tests();
+
+int ht_image_test()
+{
+    RUNIT_RUN(ht_image_tests);
+    RUNIT_RUN(ht_image_invalid_tests);
+
+    return runit_fail == 0;
+}
+
+#define IMAGE_TEST_PATH "ht_image_test.bin"
+
+struct image_item {
+    unsigned int key;
+    unsigned int value;
+    char name[20];
+};
+
+static ht_bool image_items_are_same(struct image_item* left, struct image_item* right)
+{
+    return left->key == right->key;
+}
+
+static ht_hash_t image_item_hash(struct image_item* item)
+{
+    ht_hash_t h = (ht_hash_t)item->key * (ht_hash_t)0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+static void init_image_ht(ht* h, ht_bool separate_metadata)
+{
+    ht_options options;
+    ht_options_init(&options);
+    options.separate_metadata = separate_metadata;
+    ht_init_ex(h, sizeof(struct image_item), (ht_hash_function_t)image_item_hash, (ht_predicate_t)image_items_are_same, 0, 0, &options);
+}
+
+static int write_image_file(ht* h)
+{
+    FILE* file = fopen(IMAGE_TEST_PATH, "wb");
+    if (!file)
+        return 0;
+    int written = ht_write_image(h, fileno(file));
+    fclose(file);
+    return written;
+}
+
+static int map_image_file(ht* h, ht_size_t sizeof_item)
+{
+    return ht_map_image(h, IMAGE_TEST_PATH, sizeof_item, (ht_hash_function_t)image_item_hash, (ht_predicate_t)image_items_are_same);
+}
+
+/* Write the image with another header, followed by memory_size bytes of 'memory'. */
+static void write_image_with_header(const ht__image_header* header, const char* memory)
+{
+    ht__image_header_block block;
+    memset(&block, 0, sizeof(block));
+    block.header = *header;
+
+    FILE* file = fopen(IMAGE_TEST_PATH, "wb");
+    fwrite(&block, 1, sizeof(block), file);
+    fwrite(memory, 1, header->memory_size, file);
+    fclose(file);
+}
+
+static void ht_image_tests()
+{
+    for (int separate_metadata = 0; separate_metadata < 2; ++separate_metadata)
+    {
+        ht h;
+        init_image_ht(&h, separate_metadata);
+
+        for (unsigned int i = 0; i < 5000; ++i)
+        {
+            struct image_item item = { i, i * 3, { 0 } };
+            snprintf(item.name, sizeof(item.name), "item %u", i);
+            ht_insert(&h, &item);
+        }
+        /* Erased items leave stale data in their bucket. */
+        for (unsigned int i = 0; i < 5000; i += 2)
+        {
+            struct image_item item = { i, 0, { 0 } };
+            ht_erase(&h, &item);
+        }
+
+        RUNIT_ASSERT(write_image_file(&h));
+
+        ht mapped;
+        RUNIT_ASSERT(map_image_file(&mapped, sizeof(struct image_item)));
+        RUNIT_ASSERT(ht_size(&mapped) == 2500);
+        RUNIT_ASSERT(mapped.bucket_capacity == h.bucket_capacity);
+        RUNIT_ASSERT(mapped.separate_metadata == h.separate_metadata);
+
+        int all_found = 1;
+        for (unsigned int i = 0; i < 5000; ++i)
+        {
+            struct image_item key = { i, 0, { 0 } };
+            struct image_item* found = (struct image_item*)ht_get_item(&mapped, &key);
+            if (i % 2 == 0)
+            {
+                all_found = all_found && !found;
+            }
+            else
+            {
+                char name[20];
+                snprintf(name, sizeof(name), "item %u", i);
+                all_found = all_found && found && found->value == i * 3 && strcmp(found->name, name) == 0;
+            }
+        }
+        RUNIT_ASSERT(all_found);
+
+        ht_statistics expected, actual;
+        ht_stats(&h, &expected);
+        ht_stats(&mapped, &actual);
+        RUNIT_ASSERT(expected.max_distance == actual.max_distance);
+        RUNIT_ASSERT(expected.cluster_count == actual.cluster_count);
+
+        ht_size_t visited = 0;
+        ht_cursor cursor;
+        ht_cursor_init(&mapped, &cursor);
+        while (ht_cursor_next(&cursor))
+            visited += 1;
+        RUNIT_ASSERT(visited == 2500);
+
+        ht_destroy(&mapped);
+        ht_destroy(&h);
+    }
+
+    /* Empty table. */
+    ht h;
+    init_image_ht(&h, 0);
+    RUNIT_ASSERT(write_image_file(&h));
+
+    ht mapped;
+    RUNIT_ASSERT(map_image_file(&mapped, sizeof(struct image_item)));
+    RUNIT_ASSERT(ht_size(&mapped) == 0);
+    struct image_item key = { 1, 0, { 0 } };
+    RUNIT_ASSERT(!ht_contains(&mapped, &key));
+    ht_destroy(&mapped);
+    ht_destroy(&h);
+
+    remove(IMAGE_TEST_PATH);
+}
+
+static void ht_image_invalid_tests()
+{
+    ht h;
+    ht mapped;
+
+    RUNIT_ASSERT(!map_image_file(&mapped, sizeof(struct image_item)));
+
+    init_image_ht(&h, 0);
+    for (unsigned int i = 0; i < 100; ++i)
+    {
+        struct image_item item = { i, i, { 0 } };
+        ht_insert(&h, &item);
+    }
+    RUNIT_ASSERT(write_image_file(&h));
+    ht_destroy(&h);
+
+    /* Another item size. */
+    RUNIT_ASSERT(!map_image_file(&mapped, sizeof(struct image_item) + 8));
+
+    /* Truncated file. */
+    FILE* file = fopen(IMAGE_TEST_PATH, "rb");
+    static char content[1 << 16];
+    size_t size = fread(content, 1, sizeof(content), file);
+    fclose(file);
+
+    file = fopen(IMAGE_TEST_PATH, "wb");
+    fwrite(content, 1, size - 1, file);
+    fclose(file);
+    RUNIT_ASSERT(!map_image_file(&mapped, sizeof(struct image_item)));
+
+    /* Corrupt headers. */
+    ht__image_header original;
+    memcpy(&original, content, sizeof(original));
+    const char* memory = content + HT_IMAGE_HEADER_SIZE;
+    RUNIT_ASSERT(original.bucket_capacity == 256);
+
+    ht__image_header header;
+    int all_rejected = 1;
+    for (int field = 0; field < 14; ++field)
+    {
+        header = original;
+        switch (field)
+        {
+        case 0: header.magic[0] = 'X'; break;
+        case 1: header.version += 1; break;
+        case 2: header.endianness = ~header.endianness; break;
+        case 3: header.sizeof_size = 4 + 8 - sizeof(ht_size_t); break;
+        case 4: header.separate_metadata = 2; break;
+        case 5: header.filled_bucket_count = header.bucket_capacity; break;
+        case 6: header.max_distance = header.bucket_capacity; break;
+        case 7: header.memory_size -= 1; break;
+        case 8: header.max_load = 1.5f; break;
+        case 9: { unsigned int nan_bits = 0x7fc00000u; memcpy(&header.max_load, &nan_bits, sizeof(float)); } break;
+        case 10: header.min_load = 0.5f; break;
+        case 11: header.growth_factor = 3; break;
+        case 12: header.min_capacity = 0; break;
+        case 13: header.bucket_capacity = 0; break;
+        }
+        write_image_with_header(&header, memory);
+        all_rejected = all_rejected && !map_image_file(&mapped, sizeof(struct image_item));
+    }
+    RUNIT_ASSERT(all_rejected);
+
+    /* Not a power of two, with the memory size of that capacity. */
+    header = original;
+    ht_size_t sizeof_bucket = (original.memory_size - 2 * original.bucket_capacity) / (original.bucket_capacity + 2);
+    header.bucket_capacity = 200;
+    header.filled_bucket_count = 100;
+    header.memory_size = header.bucket_capacity * (sizeof_bucket + 2) + 2 * sizeof_bucket;
+    write_image_with_header(&header, memory);
+    RUNIT_ASSERT(!map_image_file(&mapped, sizeof(struct image_item)));
+
+    /* The unchanged header is still valid. */
+    write_image_with_header(&original, memory);
+    RUNIT_ASSERT(map_image_file(&mapped, sizeof(struct image_item)));
+    RUNIT_ASSERT(ht_size(&mapped) == 100);
+    ht_destroy(&mapped);
+
+    /* Not an image. */
+    file = fopen(IMAGE_TEST_PATH, "wb");
+    memset(content, 'x', sizeof(content));
+    fwrite(content, 1, size, file);
+    fclose(file);
+    RUNIT_ASSERT(!map_image_file(&mapped, sizeof(struct image_item)));
+
+    remove(IMAGE_TEST_PATH);
+}
@@ -0,0 +1,14 @@
+#ifndef RE_HT_IMAGE_TEST_H
+#define RE_HT_IMAGE_TEST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int ht_image_test();
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* RE_HT_IMAGE_TEST_H */
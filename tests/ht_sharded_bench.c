@@ -0,0 +1,120 @@
+/*
+    Build time of a ht_sharded.h table with several threads compared to a single ht,
+    this is not part of the tests run by main.c.
+
+    Build and run with:
+        cc -O2 -pthread tests/ht_sharded_bench.c -o ht_sharded_bench && ./ht_sharded_bench
+
+    The max number of threads can be given, it's the number of cores by default:
+        ./ht_sharded_bench 32
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h> /* sysconf */
+
+#define HT_IMPLEMENTATION
+#include "../ht_sharded.h"
+
+#define ITEM_COUNT (1 << 22)
+#define SHARD_COUNT 256
+
+struct item {
+    uint64_t key;
+    uint64_t value;
+};
+
+static ht_hash_t
+hash_item(struct item* item)
+{
+    /* splitmix64 finalizer */
+    uint64_t x = item->key;
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (ht_hash_t)x;
+}
+
+static ht_bool
+items_are_same(struct item* left, struct item* right)
+{
+    return left->key == right->key;
+}
+
+static double
+now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+static void
+lookup_all(ht_sharded* s, struct item* items)
+{
+    uint64_t found = 0;
+    double start = now_ms();
+    for (uint64_t i = 0; i < ITEM_COUNT; ++i)
+        found += ht_sharded_contains(s, &items[i]);
+    double elapsed = now_ms() - start;
+
+    printf("%-32s %8.1f ms (found %llu)\n", "ht_sharded lookups", elapsed, (unsigned long long)found);
+}
+
+int
+main(int argc, char** argv)
+{
+    long max_threads = argc > 1 ? atol(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads < 1)
+        max_threads = 1;
+
+    struct item* items = (struct item*)malloc(ITEM_COUNT * sizeof(struct item));
+    uint64_t seed = 42;
+    for (uint64_t i = 0; i < ITEM_COUNT; ++i)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        items[i].key = seed;
+        items[i].value = i;
+    }
+
+    printf("%d items, %d shards\n", ITEM_COUNT, SHARD_COUNT);
+
+    {
+        ht h;
+        ht_init(&h, sizeof(struct item), (ht_hash_function_t)hash_item, (ht_predicate_t)items_are_same, 0, 0);
+
+        double start = now_ms();
+        for (uint64_t i = 0; i < ITEM_COUNT; ++i)
+            ht_insert(&h, &items[i]);
+        double elapsed = now_ms() - start;
+
+        printf("%-32s %8.1f ms\n", "ht_insert loop", elapsed);
+        ht_destroy(&h);
+    }
+
+    for (long thread_count = 1; thread_count <= max_threads; thread_count *= 2)
+    {
+        ht_sharded s;
+        ht_sharded_init(&s, sizeof(struct item), (ht_hash_function_t)hash_item, (ht_predicate_t)items_are_same, SHARD_COUNT, 0);
+
+        double start = now_ms();
+        ht_size_t inserted = ht_sharded_insert_many(&s, items, ITEM_COUNT, (ht_size_t)thread_count);
+        double elapsed = now_ms() - start;
+
+        char label[64];
+        snprintf(label, sizeof(label), "ht_sharded_insert_many %ld threads", thread_count);
+        printf("%-32s %8.1f ms (inserted %llu)\n", label, elapsed, (unsigned long long)inserted);
+
+        if (thread_count == 1)
+            lookup_all(&s, items);
+
+        ht_sharded_destroy(&s);
+    }
+
+    free(items);
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include "ht_sharded_test.h"
+
+#include "runit.h"
+
+#define HT_IMPLEMENTATION
+#include "../ht_sharded.h"
+
+static void ht_sharded_tests();
+static void ht_sharded_insert_many_tests();
+
+int ht_sharded_test()
+{
+    RUNIT_RUN(ht_sharded_tests);
+    RUNIT_RUN(ht_sharded_insert_many_tests);
+
+    return runit_fail == 0;
+}
+
+struct entry {
+    unsigned int key;
+    unsigned int value;
+};
+
+static ht_bool entries_are_same(struct entry* left, struct entry* right)
+{
+    return left->key == right->key;
+}
+
+static ht_hash_t entry_hash(struct entry* e)
+{
+    /* Spread keys over the high bits too, they select the shard. */
+    ht_hash_t h = (ht_hash_t)e->key * (ht_hash_t)0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+static void init_sharded(ht_sharded* s, ht_size_t shard_count)
+{
+    ht_sharded_init(s, sizeof(struct entry), (ht_hash_function_t)entry_hash, (ht_predicate_t)entries_are_same, shard_count, 0);
+}
+
+/* Every item is in the shard of its hash. */
+static int items_are_in_their_shard(ht_sharded* s)
+{
+    for (ht_size_t i = 0; i < s->shard_count; ++i)
+    {
+        ht* shard = &s->shards[i];
+        ht_cursor cursor;
+        ht_cursor_init(shard, &cursor);
+        while (ht_cursor_next(&cursor))
+        {
+            if (ht_sharded_shard(s, ht_sharded_hash(s, ht_cursor_item(&cursor))) != shard)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+static void ht_sharded_tests()
+{
+    ht_sharded s;
+    init_sharded(&s, 6);
+
+    RUNIT_ASSERT(s.shard_count == 8);
+
+    for (unsigned int i = 0; i < 1000; ++i)
+    {
+        struct entry e = { i, i * 2 };
+        ht_sharded_insert(&s, &e);
+    }
+
+    RUNIT_ASSERT(ht_sharded_size(&s) == 1000);
+    RUNIT_ASSERT(items_are_in_their_shard(&s));
+
+    /* Items are spread in all shards. */
+    int all_shards_used = 1;
+    for (ht_size_t i = 0; i < s.shard_count; ++i)
+        all_shards_used = all_shards_used && ht_size(&s.shards[i]) > 0;
+    RUNIT_ASSERT(all_shards_used);
+
+    struct entry e = { 10, 0 };
+    struct entry* found = (struct entry*)ht_sharded_get_item(&s, &e);
+    RUNIT_ASSERT(found && found->value == 20);
+
+    e.value = 7;
+    RUNIT_ASSERT(!ht_sharded_insert(&s, &e));
+    found = (struct entry*)ht_sharded_get_item(&s, &e);
+    RUNIT_ASSERT(found && found->value == 7);
+
+    RUNIT_ASSERT(ht_sharded_erase(&s, &e));
+    RUNIT_ASSERT(!ht_sharded_contains(&s, &e));
+    RUNIT_ASSERT(!ht_sharded_erase(&s, &e));
+    RUNIT_ASSERT(ht_sharded_size(&s) == 999);
+
+    ht_sharded_destroy(&s);
+}
+
+static void ht_sharded_insert_many_tests()
+{
+    const unsigned int count = 100000;
+    struct entry* entries = (struct entry*)malloc(count * sizeof(struct entry));
+
+    /* Second half contains the same keys as the first half. */
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        entries[i].key = i % (count / 2);
+        entries[i].value = i;
+    }
+
+    ht_size_t thread_counts[] = { 1, 4, 100 };
+    for (int t = 0; t < 3; ++t)
+    {
+        ht_sharded s;
+        init_sharded(&s, 16);
+
+        struct entry existing = { count, 1 };
+        ht_sharded_insert(&s, &existing);
+
+        RUNIT_ASSERT(ht_sharded_insert_many(&s, entries, count, thread_counts[t]) == count / 2);
+        RUNIT_ASSERT(ht_sharded_size(&s) == count / 2 + 1);
+        RUNIT_ASSERT(items_are_in_their_shard(&s));
+
+        /* Last inserted items replace the first ones. */
+        int all_found = 1;
+        for (unsigned int i = 0; i < count / 2; ++i)
+        {
+            struct entry e = { i, 0 };
+            struct entry* found = (struct entry*)ht_sharded_get_item(&s, &e);
+            all_found = all_found && found && found->value == i + count / 2;
+        }
+        RUNIT_ASSERT(all_found);
+        RUNIT_ASSERT(ht_sharded_contains(&s, &existing));
+
+        RUNIT_ASSERT(ht_sharded_insert_many(&s, entries, 0, thread_counts[t]) == 0);
+
+        ht_sharded_destroy(&s);
+    }
+
+    /* Shards are sized once, 112000 items over 16 shards is above 3/4 of a power of two per shard. */
+    {
+        const unsigned int distinct_count = 112000;
+        struct entry* distinct = (struct entry*)malloc(distinct_count * sizeof(struct entry));
+        for (unsigned int i = 0; i < distinct_count; ++i)
+        {
+            distinct[i].key = i;
+            distinct[i].value = i;
+        }
+
+        ht_sharded s;
+        init_sharded(&s, 16);
+        RUNIT_ASSERT(ht_sharded_insert_many(&s, distinct, distinct_count, 1) == distinct_count);
+
+        int no_growth = 1;
+        for (ht_size_t i = 0; i < s.shard_count; ++i)
+            no_growth = no_growth && s.shards[i].grow_count == 0;
+        RUNIT_ASSERT(no_growth);
+
+        ht_sharded_destroy(&s);
+        free(distinct);
+    }
+
+    free(entries);
+}
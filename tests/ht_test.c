@@ -6,10 +6,38 @@
 #include "../ht.h"
 
 static void ht_tests();
+static void ht_separate_metadata_tests();
+static void ht_define_tests();
+static void ht_distance_tests();
+static void ht_grow_tests();
+static void ht_incremental_tests();
+static void ht_load_tests();
+static void ht_batch_tests();
+static void ht_insert_many_tests();
+static void ht_allocator_tests();
+static void ht_key_tests();
+static void ht_find_or_insert_tests();
+static void ht_cursor_erase_tests();
+static void ht_shrink_tests();
+static void ht_stats_tests();
 
 int ht_test()
 {
     RUNIT_RUN(ht_tests);
+    RUNIT_RUN(ht_separate_metadata_tests);
+    RUNIT_RUN(ht_define_tests);
+    RUNIT_RUN(ht_distance_tests);
+    RUNIT_RUN(ht_grow_tests);
+    RUNIT_RUN(ht_incremental_tests);
+    RUNIT_RUN(ht_load_tests);
+    RUNIT_RUN(ht_batch_tests);
+    RUNIT_RUN(ht_insert_many_tests);
+    RUNIT_RUN(ht_allocator_tests);
+    RUNIT_RUN(ht_key_tests);
+    RUNIT_RUN(ht_find_or_insert_tests);
+    RUNIT_RUN(ht_cursor_erase_tests);
+    RUNIT_RUN(ht_shrink_tests);
+    RUNIT_RUN(ht_stats_tests);
     
     return runit_fail == 0;
 }
@@ -115,4 +143,1086 @@ static void ht_tests()
     }
     ht_clear(&ht);
     RUNIT_ASSERT(ht_size(&ht) == 0);
+
+    ht_destroy(&ht);
+}
+
+struct int_item {
+    int key;
+    int value;
+};
+
+static ht_bool int_items_are_same(struct int_item* left, struct int_item* right)
+{
+    return left->key == right->key;
+}
+
+static void swap_int_items(struct int_item* left, struct int_item* right)
+{
+    struct int_item tmp = *left;
+    *left = *right;
+    *right = tmp;
+}
+
+static ht_hash_t int_hash(struct int_item* i)
+{
+    /* Knuth's multiplicative hash, the low bits are good enough for our tests. */
+    return (ht_hash_t)((unsigned int)i->key * 2654435761u);
+}
+
+static void init_int_ht(ht* h, const ht_options* options)
+{
+    ht_init_ex(h,
+        sizeof(struct int_item),
+        (ht_hash_function_t)int_hash,
+        (ht_predicate_t)int_items_are_same,
+        (ht_swap_function_t)swap_int_items,
+        0,
+        options);
+}
+
+/* Insert, find and erase many items, checking that the table stays consistent. */
+static void check_many_int_items(ht* h)
+{
+    const int count = 1000;
+    int all_found = 1;
+
+    for (int i = 0; i < count; ++i)
+    {
+        struct int_item item = { i, i * 2 };
+        ht_insert(h, &item);
+    }
+
+    RUNIT_ASSERT(ht_size(h) == (ht_size_t)count);
+    RUNIT_ASSERT(ht_count(h) == (ht_size_t)count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        struct int_item item = { i, 0 };
+        struct int_item* found = (struct int_item*)ht_get_item(h, &item);
+        all_found = all_found && found && found->value == i * 2;
+    }
+    RUNIT_ASSERT(all_found);
+
+    /* Erase even keys. */
+    for (int i = 0; i < count; i += 2)
+    {
+        struct int_item item = { i, 0 };
+        ht_erase(h, &item);
+    }
+
+    RUNIT_ASSERT(ht_size(h) == (ht_size_t)count / 2);
+    RUNIT_ASSERT(ht_count(h) == (ht_size_t)count / 2);
+
+    int only_odd_found = 1;
+    for (int i = 0; i < count; ++i)
+    {
+        struct int_item item = { i, 0 };
+        only_odd_found = only_odd_found && (ht_contains(h, &item) == (ht_bool)(i % 2));
+    }
+    RUNIT_ASSERT(only_odd_found);
+
+    /* Iterate over remaining items. */
+    ht_size_t iterated = 0;
+    ht_cursor cursor;
+    ht_cursor_init(h, &cursor);
+    while (ht_cursor_next(&cursor))
+    {
+        struct int_item* item = (struct int_item*)ht_cursor_item(&cursor);
+        iterated += (item->key % 2) ? 1 : 0;
+    }
+    RUNIT_ASSERT(iterated == (ht_size_t)count / 2);
+}
+
+static void ht_separate_metadata_tests()
+{
+    ht h;
+    ht_options options;
+    ht_options_init(&options);
+    options.separate_metadata = 1;
+
+    init_int_ht(&h, &options);
+    RUNIT_ASSERT(h.separate_metadata);
+    RUNIT_ASSERT(h.item_offset == 0);
+
+    check_many_int_items(&h);
+
+    ht_clear(&h);
+    RUNIT_ASSERT(ht_size(&h) == 0);
+    RUNIT_ASSERT(ht_count(&h) == 0);
+
+    ht_destroy(&h);
+
+    /* Inline metadata, for comparison. */
+    init_int_ht(&h, 0);
+    RUNIT_ASSERT(!h.separate_metadata);
+    check_many_int_items(&h);
+    ht_destroy(&h);
+}
+
+static ht_hash_t hash_int(int key)
+{
+    return (ht_hash_t)((unsigned int)key * 2654435761u);
+}
+
+static ht_bool ints_are_same(int left, int right)
+{
+    return left == right;
+}
+
+HT_DEFINE(int_map, int, float, hash_int, ints_are_same)
+
+static void ht_define_tests()
+{
+    int_map m;
+    int_map_init(&m);
+
+    RUNIT_ASSERT(int_map_size(&m) == 0);
+    RUNIT_ASSERT(!int_map_contains(&m, 1));
+    RUNIT_ASSERT(int_map_get(&m, 1) == 0);
+
+    RUNIT_ASSERT(int_map_insert(&m, 1, 3.14f));
+    RUNIT_ASSERT(!int_map_insert(&m, 1, 6.28f)); /* Value is replaced. */
+    RUNIT_ASSERT(int_map_size(&m) == 1);
+    RUNIT_ASSERT(*int_map_get(&m, 1) == 6.28f);
+
+    const int count = 1000;
+    for (int i = 0; i < count; ++i)
+    {
+        int_map_insert(&m, i, (float)i);
+    }
+    RUNIT_ASSERT(int_map_size(&m) == (ht_size_t)count);
+
+    int all_found = 1;
+    for (int i = 0; i < count; ++i)
+    {
+        float* value = int_map_get(&m, i);
+        all_found = all_found && value && *value == (float)i;
+    }
+    RUNIT_ASSERT(all_found);
+
+    /* Erase even keys. */
+    for (int i = 0; i < count; i += 2)
+    {
+        int_map_erase(&m, i);
+    }
+    RUNIT_ASSERT(int_map_size(&m) == (ht_size_t)count / 2);
+    RUNIT_ASSERT(!int_map_erase(&m, 0));
+
+    int only_odd_found = 1;
+    for (int i = 0; i < count; ++i)
+    {
+        only_odd_found = only_odd_found && (int_map_contains(&m, i) == (ht_bool)(i % 2));
+    }
+    RUNIT_ASSERT(only_odd_found);
+
+    int_map_clear(&m);
+    RUNIT_ASSERT(int_map_size(&m) == 0);
+    RUNIT_ASSERT(!int_map_contains(&m, 1));
+
+    int_map_destroy(&m);
+}
+
+/* All items have the same ideal bucket until the table grows over 2^20 buckets. */
+static ht_hash_t colliding_int_hash(struct int_item* i)
+{
+    return ((ht_hash_t)i->key + 1) << 20;
+}
+
+static void ht_distance_tests()
+{
+    ht h;
+    ht_init(&h,
+        sizeof(struct int_item),
+        (ht_hash_function_t)colliding_int_hash,
+        (ht_predicate_t)int_items_are_same,
+        (ht_swap_function_t)swap_int_items,
+        0);
+
+    /* Distances don't fit in a byte anymore. */
+    const int count = 400;
+    for (int i = 0; i < count; ++i)
+    {
+        struct int_item item = { i, i };
+        ht_insert(&h, &item);
+    }
+
+    RUNIT_ASSERT(h.max_distance == (ht_size_t)count - 1);
+
+    int all_found = 1;
+    for (int i = 0; i < count; ++i)
+    {
+        struct int_item item = { i, 0 };
+        struct int_item* found = (struct int_item*)ht_get_item(&h, &item);
+        all_found = all_found && found && found->value == i;
+    }
+    RUNIT_ASSERT(all_found);
+
+    struct int_item not_expected = { count, 0 };
+    RUNIT_ASSERT(!ht_contains(&h, &not_expected));
+
+    /* Erase first items so that others are shifted back. */
+    for (int i = 0; i < count / 2; ++i)
+    {
+        struct int_item item = { i, 0 };
+        ht_erase(&h, &item);
+    }
+
+    int only_last_found = 1;
+    for (int i = 0; i < count; ++i)
+    {
+        struct int_item item = { i, 0 };
+        only_last_found = only_last_found && (ht_contains(&h, &item) == (ht_bool)(i >= count / 2));
+    }
+    RUNIT_ASSERT(only_last_found);
+    RUNIT_ASSERT(ht_size(&h) == (ht_size_t)count / 2);
+
+    ht_clear(&h);
+    RUNIT_ASSERT(h.max_distance == 0);
+
+    ht_destroy(&h);
+}
+
+/* Check that cached distances are right and that the Robin Hood order is respected. */
+static int ht_is_consistent(const ht* h)
+{
+    ht_size_t count = 0;
+    for (ht_size_t i = 0; i < h->bucket_capacity; ++i)
+    {
+        ht_size_t next = (i + 1) & (h->bucket_capacity - 1);
+        if (ht__bucket_is_empty_at(h, i))
+        {
+            if (h->distances[i] != 0 || ht__distance_at(h, next) != 0)
+                return 0;
+            continue;
+        }
+
+        count += 1;
+        ht_size_t distance = ht__bucket_distance(h, i, *ht__hash_at(h, i));
+        if (ht__distance_at(h, i) != distance
+            || distance > h->max_distance
+            || ht__fingerprint(*ht__hash_at(h, i)) != h->ctrl[i]
+            || (!ht__bucket_is_empty_at(h, next) && ht__distance_at(h, next) > distance + 1))
+            return 0;
+    }
+    return count == ht_size(h);
+}
+
+/* All items have their ideal bucket at the end of a table of 16 buckets, so the cluster wraps around.
+   Once the table grows they are split between the end of the first half and the end of the second half. */
+static ht_hash_t wrapping_int_hash(struct int_item* i)
+{
+    return (ht_hash_t)0xE | ((ht_hash_t)i->key << 4);
+}
+
+static void ht_grow_tests()
+{
+    ht_hash_function_t hashes[] = { (ht_hash_function_t)wrapping_int_hash, (ht_hash_function_t)int_hash };
+
+    for (int separate_metadata = 0; separate_metadata < 2; ++separate_metadata)
+    for (int hash_index = 0; hash_index < 2; ++hash_index)
+    {
+        ht h;
+        ht_options options;
+        ht_options_init(&options);
+        options.separate_metadata = separate_metadata;
+
+        ht_init_ex(&h,
+            sizeof(struct int_item),
+            hashes[hash_index],
+            (ht_predicate_t)int_items_are_same,
+            (ht_swap_function_t)swap_int_items,
+            16,
+            &options);
+
+        const int count = 12;
+        for (int i = 0; i < count; ++i)
+        {
+            struct int_item item = { i, i };
+            ht_insert(&h, &item);
+        }
+        RUNIT_ASSERT(h.bucket_capacity == 16);
+        RUNIT_ASSERT(ht_is_consistent(&h));
+
+        ht_reserve(&h, 64);
+        RUNIT_ASSERT(h.bucket_capacity == 64);
+        RUNIT_ASSERT(ht_is_consistent(&h));
+
+        int all_found = 1;
+        for (int i = 0; i < count; ++i)
+        {
+            struct int_item item = { i, 0 };
+            struct int_item* found = (struct int_item*)ht_get_item(&h, &item);
+            all_found = all_found && found && found->value == i;
+        }
+        RUNIT_ASSERT(all_found);
+
+        /* Grow by inserting. */
+        for (int i = count; i < 1000; ++i)
+        {
+            struct int_item item = { i, i };
+            ht_insert(&h, &item);
+        }
+        RUNIT_ASSERT(ht_is_consistent(&h));
+        RUNIT_ASSERT(ht_size(&h) == 1000);
+
+        ht_destroy(&h);
+    }
+}
+
+static void ht_incremental_tests()
+{
+    for (int separate_metadata = 0; separate_metadata < 2; ++separate_metadata)
+    {
+        ht h;
+        ht_options options;
+        ht_options_init(&options);
+        options.separate_metadata = separate_metadata;
+        options.incremental_resize = 1;
+
+        init_int_ht(&h, &options);
+
+        const int count = 1000;
+        int migration_seen = 0;
+        int all_found = 1;
+        for (int i = 0; i < count; ++i)
+        {
+            struct int_item item = { i, i };
+            ht_insert(&h, &item);
+
+            if (h.migrating)
+            {
+                migration_seen = 1;
+
+                /* Items are found in both tables. */
+                for (int j = 0; j <= i; ++j)
+                {
+                    struct int_item key = { j, 0 };
+                    struct int_item* found = (struct int_item*)ht_get_item(&h, &key);
+                    all_found = all_found && found && found->value == j;
+                }
+            }
+        }
+        RUNIT_ASSERT(migration_seen);
+        RUNIT_ASSERT(all_found);
+        RUNIT_ASSERT(ht_size(&h) == (ht_size_t)count);
+        RUNIT_ASSERT(ht_count(&h) == (ht_size_t)count);
+
+        /* Grow again to update and erase items while they are being moved. */
+        int i = count;
+        while (!h.migrating)
+        {
+            struct int_item item = { i, i };
+            ht_insert(&h, &item);
+            i += 1;
+        }
+        const int total = i;
+
+        RUNIT_ASSERT(h.migrating != 0);
+        int none_inserted = 1;
+        for (int j = 0; j < total; j += 2)
+        {
+            struct int_item item = { j, -j };
+            none_inserted = none_inserted && !ht_insert(&h, &item);
+        }
+        RUNIT_ASSERT(none_inserted);
+        for (int j = 0; j < total; j += 3)
+        {
+            struct int_item item = { j, 0 };
+            ht_erase(&h, &item);
+        }
+        RUNIT_ASSERT(h.migrating == 0);
+        RUNIT_ASSERT(ht_is_consistent(&h));
+
+        int all_expected = 1;
+        for (int j = 0; j < total; ++j)
+        {
+            struct int_item key = { j, 0 };
+            struct int_item* found = (struct int_item*)ht_get_item(&h, &key);
+            if (j % 3 == 0)
+                all_expected = all_expected && !found;
+            else
+                all_expected = all_expected && found && found->value == ((j % 2) ? j : -j);
+        }
+        RUNIT_ASSERT(all_expected);
+
+        ht_destroy(&h);
+
+        /* Lookups do not move buckets, ht_reserve and ht_shrink_to_fit finish the migration. */
+        for (int finish_with_shrink = 0; finish_with_shrink < 2; ++finish_with_shrink)
+        {
+            init_int_ht(&h, &options);
+            int key_count = 0;
+            while (!h.migrating)
+            {
+                struct int_item item = { key_count, key_count };
+                ht_insert(&h, &item);
+                key_count += 1;
+            }
+
+            for (int j = 0; j < key_count; ++j)
+            {
+                struct int_item key = { j, 0 };
+                ht_get_item(&h, &key);
+            }
+            RUNIT_ASSERT(h.migrating != 0);
+
+            if (finish_with_shrink)
+                ht_shrink_to_fit(&h);
+            else
+                ht_reserve(&h, ht_size(&h) + 1);
+
+            RUNIT_ASSERT(h.migrating == 0);
+            RUNIT_ASSERT(ht_size(&h) == (ht_size_t)key_count);
+            RUNIT_ASSERT(ht_is_consistent(&h));
+
+            int all_moved = 1;
+            for (int j = 0; j < key_count; ++j)
+            {
+                struct int_item key = { j, 0 };
+                struct int_item* found = (struct int_item*)ht_get_item(&h, &key);
+                all_moved = all_moved && found && found->value == j;
+            }
+            RUNIT_ASSERT(all_moved);
+
+            ht_destroy(&h);
+        }
+
+        init_int_ht(&h, &options);
+        check_many_int_items(&h);
+        RUNIT_ASSERT(ht_is_consistent(&h));
+        ht_destroy(&h);
+    }
+}
+
+/* Insert keys [first, last) */
+static void insert_int_items(ht* h, int first, int last)
+{
+    for (int i = first; i < last; ++i)
+    {
+        struct int_item item = { i, i };
+        ht_insert(h, &item);
+    }
+}
+
+static void ht_load_tests()
+{
+    ht h;
+    ht_options options;
+
+    /* Default settings. */
+    init_int_ht(&h, 0);
+    insert_int_items(&h, 0, 12);
+    RUNIT_ASSERT(h.bucket_capacity == 16);
+    insert_int_items(&h, 12, 13);
+    RUNIT_ASSERT(h.bucket_capacity == 32);
+    ht_destroy(&h);
+
+    /* Low load. */
+    ht_options_init(&options);
+    options.max_load = 0.5f;
+    init_int_ht(&h, &options);
+    insert_int_items(&h, 0, 8);
+    RUNIT_ASSERT(h.bucket_capacity == 16);
+    insert_int_items(&h, 8, 9);
+    RUNIT_ASSERT(h.bucket_capacity == 32);
+    ht_destroy(&h);
+
+    /* High load and faster growth. */
+    ht_options_init(&options);
+    options.max_load = 0.9f;
+    options.growth_factor = 4;
+    init_int_ht(&h, &options);
+    insert_int_items(&h, 0, 14);
+    RUNIT_ASSERT(h.bucket_capacity == 16);
+    insert_int_items(&h, 14, 15);
+    RUNIT_ASSERT(h.bucket_capacity == 64);
+    insert_int_items(&h, 15, 1000);
+    RUNIT_ASSERT(ht_is_consistent(&h));
+    RUNIT_ASSERT(ht_size(&h) == 1000);
+    ht_destroy(&h);
+
+    /* Small min capacity, rounded up to a power of two. */
+    ht_options_init(&options);
+    options.min_capacity = 3;
+    init_int_ht(&h, &options);
+    insert_int_items(&h, 0, 1);
+    RUNIT_ASSERT(h.bucket_capacity == 4);
+    ht_destroy(&h);
+
+    /* Capacity grows until at least one item fits. */
+    ht_options_init(&options);
+    options.max_load = 0.05f;
+    init_int_ht(&h, &options);
+    insert_int_items(&h, 0, 1);
+    RUNIT_ASSERT(h.bucket_capacity == 32);
+    check_many_int_items(&h);
+    RUNIT_ASSERT(ht_is_consistent(&h));
+    ht_destroy(&h);
+}
+
+static void ht_batch_tests()
+{
+    ht h;
+    init_int_ht(&h, 0);
+
+    /* Look up in an empty table. */
+    struct int_item missing = { 1, 0 };
+    void* found = &missing;
+    ht_get_items_batch(&h, &missing, 1, sizeof(missing), &found);
+    RUNIT_ASSERT(found == 0);
+
+    /* Keep even keys. */
+    for (int i = 0; i < 1000; i += 2)
+    {
+        struct int_item item = { i, i * 2 };
+        ht_insert(&h, &item);
+    }
+
+    /* Count is not a multiple of the batch size. */
+    enum { count = 1000 - 3 };
+    struct int_item keys[count];
+    ht_hash_t hashes[count];
+    void* items[count];
+    void* items_h[count];
+    for (int i = 0; i < count; ++i)
+    {
+        keys[i].key = i;
+        keys[i].value = 0;
+        hashes[i] = ht__do_hash(&h, &keys[i]);
+    }
+
+    ht_get_items_batch(&h, keys, count, sizeof(struct int_item), items);
+    ht_get_items_batch_h(&h, keys, hashes, count, sizeof(struct int_item), items_h);
+
+    int all_expected = 1;
+    for (int i = 0; i < count; ++i)
+    {
+        struct int_item* item = (struct int_item*)items[i];
+        if (i % 2)
+            all_expected = all_expected && item == 0;
+        else
+            all_expected = all_expected && item && item->value == i * 2;
+
+        all_expected = all_expected && items[i] == items_h[i];
+    }
+    RUNIT_ASSERT(all_expected);
+
+    /* Keys spread in bigger records. */
+    struct record {
+        double other;
+        struct int_item item;
+    };
+    struct record records[40];
+    for (int i = 0; i < 40; ++i)
+    {
+        records[i].other = 0.0;
+        records[i].item.key = i;
+        records[i].item.value = 0;
+    }
+
+    ht_get_items_batch(&h, &records[0].item, 40, sizeof(struct record), items);
+
+    all_expected = 1;
+    for (int i = 0; i < 40; ++i)
+    {
+        all_expected = all_expected && (items[i] == ht_get_item(&h, &records[i].item));
+    }
+    RUNIT_ASSERT(all_expected);
+
+    ht_destroy(&h);
+}
+
+static void ht_insert_many_tests()
+{
+    typedef ht_size_t (*insert_many_t)(ht* h, const void* items, ht_size_t count);
+    insert_many_t insert_many[] = { ht_insert_many, ht_insert_many_sorted };
+
+    enum { count = 1000, unique_count = 700 };
+    struct int_item items[count];
+    for (int i = 0; i < count; ++i)
+    {
+        /* Last 300 items replace the first ones. */
+        items[i].key = i % unique_count;
+        items[i].value = i;
+    }
+
+    for (int separate_metadata = 0; separate_metadata < 2; ++separate_metadata)
+    for (int sorted = 0; sorted < 2; ++sorted)
+    {
+        ht h;
+        ht_options options;
+        ht_options_init(&options);
+        options.separate_metadata = separate_metadata;
+        init_int_ht(&h, &options);
+
+        /* Empty input. */
+        RUNIT_ASSERT(insert_many[sorted](&h, items, 0) == 0);
+
+        /* Fill a table which already has items. */
+        insert_int_items(&h, 0, 10);
+        ht_size_t capacity_before = h.bucket_capacity;
+
+        RUNIT_ASSERT(insert_many[sorted](&h, items, count) == unique_count - 10);
+        RUNIT_ASSERT(ht_size(&h) == unique_count);
+        RUNIT_ASSERT(h.bucket_capacity > capacity_before);
+        RUNIT_ASSERT(ht_is_consistent(&h));
+
+        int all_found = 1;
+        for (int i = 0; i < unique_count; ++i)
+        {
+            struct int_item key = { i, 0 };
+            struct int_item* found = (struct int_item*)ht_get_item(&h, &key);
+            int expected_value = i + unique_count < count ? i + unique_count : i;
+            all_found = all_found && found && found->value == expected_value;
+        }
+        RUNIT_ASSERT(all_found);
+
+        /* Table does not grow when there is enough room. */
+        ht_size_t capacity = h.bucket_capacity;
+        RUNIT_ASSERT(insert_many[sorted](&h, items, 10) == 0);
+        RUNIT_ASSERT(h.bucket_capacity == capacity);
+
+        ht_destroy(&h);
+    }
+}
+
+struct counting_allocator {
+    ht_size_t live_bytes;
+    ht_size_t alloc_count;
+};
+
+static void* counting_alloc(struct counting_allocator* a, ht_size_t size)
+{
+    a->live_bytes += size;
+    a->alloc_count += 1;
+    return malloc(size);
+}
+
+static void counting_free(struct counting_allocator* a, void* ptr, ht_size_t size)
+{
+    a->live_bytes -= size;
+    free(ptr);
+}
+
+/* Minimal arena, blocks are only released all at once by release_all_blocks. */
+struct block_arena {
+    void* last_block;
+    ht_size_t block_count;
+};
+
+static void* block_arena_alloc(struct block_arena* arena, ht_size_t size)
+{
+    /* The previous block is linked in the header, which keeps the memory aligned for any type. */
+    void** block = (void**)malloc(2 * sizeof(void*) + size);
+    block[0] = arena->last_block;
+    arena->last_block = block;
+    arena->block_count += 1;
+    return block + 2;
+}
+
+static void release_all_blocks(struct block_arena* arena)
+{
+    while (arena->last_block)
+    {
+        void** block = (void**)arena->last_block;
+        arena->last_block = block[0];
+        free(block);
+    }
+    arena->block_count = 0;
+}
+
+static void ht_allocator_tests()
+{
+    ht h;
+    ht_options options;
+
+    /* Without realloc function. */
+    for (int incremental_resize = 0; incremental_resize < 2; ++incremental_resize)
+    {
+        struct counting_allocator counter = { 0, 0 };
+
+        ht_options_init(&options);
+        options.incremental_resize = incremental_resize;
+        options.allocator.allocate = (ht_alloc_function_t)counting_alloc;
+        options.allocator.deallocate = (ht_free_function_t)counting_free;
+        options.allocator.context = &counter;
+
+        init_int_ht(&h, &options);
+        RUNIT_ASSERT(counter.alloc_count == 0);
+
+        check_many_int_items(&h);
+        RUNIT_ASSERT(ht_is_consistent(&h));
+        RUNIT_ASSERT(counter.alloc_count > 1);
+        RUNIT_ASSERT(counter.live_bytes == ht_allocated_memory(&h));
+
+        ht_destroy(&h);
+        RUNIT_ASSERT(counter.live_bytes == 0);
+    }
+
+    /* Table in an arena, memory is released with the arena. */
+    struct block_arena arena = { 0, 0 };
+
+    ht_options_init(&options);
+    options.allocator.allocate = (ht_alloc_function_t)block_arena_alloc;
+    options.allocator.context = &arena;
+
+    init_int_ht(&h, &options);
+    check_many_int_items(&h);
+    RUNIT_ASSERT(ht_is_consistent(&h));
+    RUNIT_ASSERT(arena.block_count > 0);
+
+    ht_destroy(&h);
+    release_all_blocks(&arena);
+}
+
+/* Same hash as int_hash, from the key only. */
+static ht_hash_t int_key_hash(int* key)
+{
+    return (ht_hash_t)((unsigned int)*key * 2654435761u);
+}
+
+static ht_bool int_item_has_key(struct int_item* item, int* key)
+{
+    return item->key == *key;
+}
+
+static void ht_key_tests()
+{
+    for (int incremental_resize = 0; incremental_resize < 2; ++incremental_resize)
+    {
+        ht h;
+        ht_options options;
+        ht_options_init(&options);
+        options.incremental_resize = incremental_resize;
+        init_int_ht(&h, &options);
+
+        int all_found = 1;
+        for (int i = 0; i < 1000; ++i)
+        {
+            struct int_item item = { i, i * 3 };
+            ht_insert(&h, &item);
+
+            /* Key 0 has a reserved hash which is adjusted as for items. */
+            int key = i / 2;
+            struct int_item* found = (struct int_item*)ht_get_item_by_key(&h, &key, (ht_key_hash_function_t)int_key_hash, (ht_key_predicate_t)int_item_has_key);
+            all_found = all_found && found && found->value == key * 3;
+        }
+        RUNIT_ASSERT(all_found);
+
+        int key = 1000;
+        RUNIT_ASSERT(!ht_contains_key(&h, &key, (ht_key_hash_function_t)int_key_hash, (ht_key_predicate_t)int_item_has_key));
+        key = 999;
+        RUNIT_ASSERT(ht_contains_key(&h, &key, (ht_key_hash_function_t)int_key_hash, (ht_key_predicate_t)int_item_has_key));
+
+        struct int_item item = { 999, 0 };
+        ht_hash_t hash = ht__do_hash(&h, &item);
+        RUNIT_ASSERT(ht_get_item_by_key_h(&h, &key, hash, (ht_key_predicate_t)int_item_has_key) == ht_get_item(&h, &item));
+        RUNIT_ASSERT(ht_contains_key_h(&h, &key, hash, (ht_key_predicate_t)int_item_has_key));
+        RUNIT_ASSERT(ht_erase_key_h(&h, &key, hash, (ht_key_predicate_t)int_item_has_key));
+        RUNIT_ASSERT(!ht_contains(&h, &item));
+
+        for (key = 0; key < 999; key += 2)
+        {
+            ht_erase_key(&h, &key, (ht_key_hash_function_t)int_key_hash, (ht_key_predicate_t)int_item_has_key);
+        }
+        RUNIT_ASSERT(ht_size(&h) == 499);
+        RUNIT_ASSERT(ht_count(&h) == 499);
+
+        ht_destroy(&h);
+    }
+}
+
+static void ht_find_or_insert_tests()
+{
+    for (int incremental_resize = 0; incremental_resize < 2; ++incremental_resize)
+    {
+        ht h;
+        ht_options options;
+        ht_options_init(&options);
+        options.incremental_resize = incremental_resize;
+        init_int_ht(&h, &options);
+
+        /* Count occurences of each key. */
+        const int key_count = 300;
+        int inserted_count = 0;
+        for (int i = 0; i < 3000; ++i)
+        {
+            struct int_item item = { i % key_count, 0 };
+            ht_bool was_inserted = 0;
+            struct int_item* counter = (struct int_item*)ht_find_or_insert(&h, &item, &was_inserted);
+            counter->value += 1;
+            inserted_count += was_inserted;
+        }
+        RUNIT_ASSERT(inserted_count == key_count);
+        RUNIT_ASSERT(ht_size(&h) == (ht_size_t)key_count);
+
+        int all_counted = 1;
+        for (int i = 0; i < key_count; ++i)
+        {
+            struct int_item key = { i, 0 };
+            struct int_item* found = (struct int_item*)ht_get_item(&h, &key);
+            all_counted = all_counted && found && found->value == 10;
+        }
+        RUNIT_ASSERT(all_counted);
+
+        /* Existing item is not replaced. */
+        struct int_item item = { 5, -1 };
+        struct int_item* found = (struct int_item*)ht_find_or_insert_h(&h, &item, ht__do_hash(&h, &item), 0);
+        RUNIT_ASSERT(found->value == 10);
+        RUNIT_ASSERT(ht_is_consistent(&h));
+
+        ht_destroy(&h);
+    }
+}
+
+static void ht_cursor_erase_tests()
+{
+    ht_hash_function_t hashes[] = { (ht_hash_function_t)wrapping_int_hash, (ht_hash_function_t)int_hash };
+    int counts[] = { 12, 1000 };
+
+    for (int separate_metadata = 0; separate_metadata < 2; ++separate_metadata)
+    for (int hash_index = 0; hash_index < 2; ++hash_index)
+    {
+        ht h;
+        ht_options options;
+        ht_options_init(&options);
+        options.separate_metadata = separate_metadata;
+
+        ht_init_ex(&h,
+            sizeof(struct int_item),
+            hashes[hash_index],
+            (ht_predicate_t)int_items_are_same,
+            (ht_swap_function_t)swap_int_items,
+            16,
+            &options);
+
+        const int count = counts[hash_index];
+        insert_int_items(&h, 0, count);
+
+        /* Erase even keys while iterating, each item must be visited once. */
+        int visits[1000];
+        memset(visits, 0, sizeof(visits));
+
+        ht_cursor cursor;
+        ht_cursor_init(&h, &cursor);
+        while (ht_cursor_next(&cursor))
+        {
+            struct int_item* item = (struct int_item*)ht_cursor_item(&cursor);
+            visits[item->key] += 1;
+            if (item->key % 2 == 0)
+                ht_cursor_erase(&cursor);
+        }
+
+        int visited_once = 1;
+        for (int i = 0; i < count; ++i)
+            visited_once = visited_once && visits[i] == 1;
+        RUNIT_ASSERT(visited_once);
+        RUNIT_ASSERT(ht_size(&h) == (ht_size_t)count / 2);
+        RUNIT_ASSERT(ht_is_consistent(&h));
+
+        /* Erase everything else. */
+        ht_size_t iterated = 0;
+        ht_cursor_init(&h, &cursor);
+        while (ht_cursor_next(&cursor))
+        {
+            iterated += 1;
+            ht_cursor_erase(&cursor);
+        }
+        RUNIT_ASSERT(iterated == (ht_size_t)count / 2);
+        RUNIT_ASSERT(ht_is_empty(&h));
+        RUNIT_ASSERT(ht_count(&h) == 0);
+
+        ht_destroy(&h);
+    }
+}
+
+/* Check that keys [first, last) are in the table with their value. */
+static int has_int_items(const ht* h, int first, int last)
+{
+    int all_found = 1;
+    for (int i = first; i < last; ++i)
+    {
+        struct int_item key = { i, 0 };
+        struct int_item* found = (struct int_item*)ht_get_item(h, &key);
+        all_found = all_found && found && found->value == i;
+    }
+    return all_found;
+}
+
+static void ht_shrink_tests()
+{
+    ht h;
+    ht_options options;
+
+    for (int separate_metadata = 0; separate_metadata < 2; ++separate_metadata)
+    {
+        ht_options_init(&options);
+        options.separate_metadata = separate_metadata;
+        init_int_ht(&h, &options);
+
+        /* Nothing to shrink. */
+        ht_shrink_to_fit(&h);
+        RUNIT_ASSERT(h.bucket_capacity == 0);
+
+        insert_int_items(&h, 0, 1000);
+        ht_size_t peak_memory = ht_allocated_memory(&h);
+        for (int i = 10; i < 1000; ++i)
+        {
+            struct int_item item = { i, 0 };
+            ht_erase(&h, &item);
+        }
+        RUNIT_ASSERT(h.bucket_capacity == 2048);
+
+        ht_shrink_to_fit(&h);
+        RUNIT_ASSERT(h.bucket_capacity == 16);
+        RUNIT_ASSERT(ht_allocated_memory(&h) < peak_memory);
+        RUNIT_ASSERT(has_int_items(&h, 0, 10));
+        RUNIT_ASSERT(ht_size(&h) == 10);
+        RUNIT_ASSERT(ht_is_consistent(&h));
+
+        /* Memory is released without items. */
+        for (int i = 0; i < 10; ++i)
+        {
+            struct int_item item = { i, 0 };
+            ht_erase(&h, &item);
+        }
+        ht_shrink_to_fit(&h);
+        RUNIT_ASSERT(h.bucket_capacity == 0);
+        RUNIT_ASSERT(ht_allocated_memory(&h) == 0);
+
+        insert_int_items(&h, 0, 100);
+        RUNIT_ASSERT(has_int_items(&h, 0, 100));
+
+        ht_destroy(&h);
+    }
+
+    /* Automatic downsizing. */
+    ht_options_init(&options);
+    options.min_load = 0.25f;
+    init_int_ht(&h, &options);
+
+    insert_int_items(&h, 0, 1000);
+    RUNIT_ASSERT(h.bucket_capacity == 2048);
+
+    int capacity_never_too_big = 1;
+    for (int i = 999; i >= 20; --i)
+    {
+        struct int_item item = { i, 0 };
+        ht_erase(&h, &item);
+        capacity_never_too_big = capacity_never_too_big && (h.bucket_capacity <= 16 || ht_size(&h) >= h.bucket_capacity / 4);
+    }
+    RUNIT_ASSERT(capacity_never_too_big);
+    RUNIT_ASSERT(h.bucket_capacity == 64);
+    RUNIT_ASSERT(has_int_items(&h, 0, 20));
+    RUNIT_ASSERT(ht_is_consistent(&h));
+
+    for (int i = 0; i < 20; ++i)
+    {
+        struct int_item item = { i, 0 };
+        ht_erase(&h, &item);
+    }
+    RUNIT_ASSERT(h.bucket_capacity == 16);
+
+    ht_destroy(&h);
+}
+
+static void ht_stats_tests()
+{
+    ht h;
+    ht_statistics stats;
+    ht_options options;
+
+    init_int_ht(&h, 0);
+    ht_stats(&h, &stats);
+    RUNIT_ASSERT(stats.item_count == 0);
+    RUNIT_ASSERT(stats.bucket_capacity == 0);
+    RUNIT_ASSERT(stats.cluster_count == 0);
+    RUNIT_ASSERT(stats.bytes_per_item == 0.0f);
+
+    /* 16 to 2048 buckets. */
+    insert_int_items(&h, 0, 1000);
+    ht_stats(&h, &stats);
+    RUNIT_ASSERT(stats.item_count == 1000);
+    RUNIT_ASSERT(stats.bucket_capacity == 2048);
+    RUNIT_ASSERT(stats.load_factor == 1000.0f / 2048.0f);
+    RUNIT_ASSERT(stats.grow_count == 7);
+    RUNIT_ASSERT(stats.shrink_count == 0);
+    RUNIT_ASSERT(stats.allocated_memory == ht_allocated_memory(&h));
+    RUNIT_ASSERT(stats.bytes_per_item == (float)((double)stats.allocated_memory / 1000.0));
+    RUNIT_ASSERT(stats.max_distance <= h.max_distance);
+    RUNIT_ASSERT(stats.cluster_count > 0 && stats.max_cluster_size >= stats.mean_cluster_size);
+
+    ht_size_t histogram_total = 0;
+    for (int i = 0; i < HT_STATS_HISTOGRAM_SIZE; ++i)
+        histogram_total += stats.distance_histogram[i];
+    RUNIT_ASSERT(histogram_total == 1000);
+
+    ht_destroy(&h);
+
+    /* All items share the same ideal bucket, they form one cluster. */
+    ht_init(&h, sizeof(struct int_item), (ht_hash_function_t)colliding_int_hash, (ht_predicate_t)int_items_are_same, 0, 0);
+    insert_int_items(&h, 0, 100);
+    ht_stats(&h, &stats);
+    RUNIT_ASSERT(stats.cluster_count == 1);
+    RUNIT_ASSERT(stats.max_cluster_size == 100);
+    RUNIT_ASSERT(stats.max_distance == 99);
+    RUNIT_ASSERT(stats.mean_distance == 49.5f);
+    RUNIT_ASSERT(stats.distance_histogram[0] == 1);
+    RUNIT_ASSERT(stats.distance_histogram[HT_STATS_HISTOGRAM_SIZE - 1] == 100 - (HT_STATS_HISTOGRAM_SIZE - 1));
+    ht_destroy(&h);
+
+    /* Items of the migrating table are counted. */
+    ht_options_init(&options);
+    options.incremental_resize = 1;
+    init_int_ht(&h, &options);
+    insert_int_items(&h, 0, 13);
+    RUNIT_ASSERT(h.migrating);
+    ht_stats(&h, &stats);
+    RUNIT_ASSERT(stats.item_count == 13);
+    histogram_total = 0;
+    for (int i = 0; i < HT_STATS_HISTOGRAM_SIZE; ++i)
+        histogram_total += stats.distance_histogram[i];
+    RUNIT_ASSERT(histogram_total == 13);
+    ht_destroy(&h);
+
+    /* Shrinking. */
+    ht_options_init(&options);
+    options.min_load = 0.25f;
+    init_int_ht(&h, &options);
+    insert_int_items(&h, 0, 1000);
+    for (int i = 0; i < 1000; ++i)
+    {
+        struct int_item item = { i, 0 };
+        ht_erase(&h, &item);
+    }
+    ht_stats(&h, &stats);
+    RUNIT_ASSERT(stats.bucket_capacity == 16);
+    RUNIT_ASSERT(stats.shrink_count == 7);
+    RUNIT_ASSERT(stats.grow_count == 7);
+    ht_destroy(&h);
+
+    /* ht_insert_many grows the table at once. */
+    struct int_item many[1000];
+    for (int i = 0; i < 1000; ++i)
+    {
+        many[i].key = i;
+        many[i].value = i;
+    }
+
+    init_int_ht(&h, 0);
+    insert_int_items(&h, 0, 10);
+    ht_insert_many(&h, many, 1000);
+    ht_stats(&h, &stats);
+    RUNIT_ASSERT(stats.item_count == 1000);
+    RUNIT_ASSERT(stats.bucket_capacity == 2048);
+    RUNIT_ASSERT(stats.grow_count == 1);
+    ht_destroy(&h);
+
+    /* The first allocation is not counted as growth. */
+    init_int_ht(&h, 0);
+    ht_insert_many(&h, many, 1000);
+    ht_stats(&h, &stats);
+    RUNIT_ASSERT(stats.grow_count == 0);
+    ht_destroy(&h);
 }
@@ -5,6 +5,10 @@
 #include "darr_test.h"
 #include "darr_map_test.h"
 #include "ht_test.h"
+#include "ht_concurrent_test.h"
+#include "ht_sharded_test.h"
+#include "ht_image_test.h"
+#include "hash_test.h"
 
 int main(void)
 {
@@ -26,6 +30,18 @@ int main(void)
     if (!ht_test())
          return -1;
      
+    if (!ht_concurrent_test())
+         return -1;
+     
+    if (!ht_sharded_test())
+         return -1;
+     
+    if (!ht_image_test())
+         return -1;
+     
+    if (!hash_test())
+         return -1;
+     
     return 0;
 }
 
@@ -35,3 +51,7 @@ int main(void)
 #include "darr_test.c"
 #include "darr_map_test.c"
 #include "ht_test.c"
+#include "ht_concurrent_test.c"
+#include "ht_sharded_test.c"
+#include "ht_image_test.c"
+#include "hash_test.c"